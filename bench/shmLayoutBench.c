@@ -0,0 +1,317 @@
+// Microbenchmark for the layout of PLR's shared data area.
+//
+// Runs the same barrier-heavy access pattern that PLR generates on every
+// syscall, once on the previous packed layout (version 1) and once on the
+// current cache line aligned layout from plrSharedData.h. Every round, each
+// process marks itself inside PLR, publishes its syscall arguments, bumps the
+// fault injection event counter (with -p) and meets the others at a barrier.
+// With the packed layout these writes land on cache lines that the other
+// processes are polling, so the time per round shows the extra coherence
+// traffic. Run a single layout (-l) under `perf stat -e cache-misses` to
+// count the misses directly. Needs at least as many cores as processes to
+// show a difference, on fewer cores the processes mostly take turns.
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "plrSharedData.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Global variables & defines
+
+#define MAX_PROC 16
+
+// Layout version 1, field for field as it was before cache line alignment
+typedef struct {
+  int pid;
+  int shmFd;
+  int waitIdx;
+  pthread_cond_t cond[2];
+  syscallArgs_t syscallArgs[2];
+  unsigned long deferredHash[2];
+  int awaitingRepair;
+  int extraShmMapped;
+  int insidePLR;
+  int futexWord;
+  int futexParked;
+} legacyProcData_t;
+
+typedef struct {
+  int figureheadPid;
+  int nProc;
+  long watchdogTimeout;
+  long spinBudgetUs;
+  int curWaitIdx;
+  int condWaitCnt[2];
+  int restoring;
+  int barrierMode;
+  unsigned int barrierGen;
+  unsigned int barrierClaimGen;
+  int barrierActionIdx;
+  int checkedActionFault[2];
+  pthread_mutex_t lock;
+  int extraShmSize;
+  int insidePLRInitTrue;
+  int didProcessInit;
+  pthread_mutex_t toolLock;
+  int faultInjected;
+  int nextFaultIdx;
+  int nextFaultPid;
+  unsigned long eventCount;
+  unsigned long targetCount;
+} legacyData_t;
+
+// Pointers to the fields touched by the benchmark, so the same loop can run
+// on either layout
+typedef struct {
+  const char *name;
+  int *condWaitCnt;
+  unsigned int *barrierGen;
+  unsigned long *eventCount;
+  int *insidePLR[MAX_PROC];
+  syscallArgs_t *syscallArgs[MAX_PROC];
+} layoutFields_t;
+
+static int g_nProc = 3;
+static long g_rounds = 200000;
+static int g_pinEvents = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+// Private functions
+
+static void *mapLayout(size_t size);
+static void getLegacyFields(layoutFields_t *fields);
+static void getCurrentFields(layoutFields_t *fields);
+static double runLayout(const layoutFields_t *fields);
+static void runProcess(const layoutFields_t *fields, int idx);
+static void waitBarrier(const layoutFields_t *fields);
+static long parseLong(const char *str, const char *optName);
+static void printUsage();
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[]) {
+  const char *onlyLayout = NULL;
+  
+  int opt;
+  while ((opt = getopt(argc, argv, "hn:r:pl:")) != -1) {
+    switch (opt) {
+    case 'h':
+      printUsage();
+      return 0;
+    case 'n':
+      g_nProc = parseLong(optarg, "-n");
+      if (g_nProc < 2 || g_nProc > MAX_PROC) {
+        fprintf(stderr, "Error: -n must be between 2 and %d\n", MAX_PROC);
+        return 1;
+      }
+      break;
+    case 'r':
+      g_rounds = parseLong(optarg, "-r");
+      if (g_rounds < 1) {
+        fprintf(stderr, "Error: -r must be at least 1\n");
+        return 1;
+      }
+      break;
+    case 'p':
+      g_pinEvents = 1;
+      break;
+    case 'l':
+      if (strcmp(optarg, "legacy") != 0 && strcmp(optarg, "current") != 0) {
+        fprintf(stderr, "Error: Invalid layout for -l, must be \"legacy\" or \"current\"\n");
+        return 1;
+      }
+      onlyLayout = optarg;
+      break;
+    default:
+      printUsage();
+      return 1;
+    }
+  }
+  
+  printf("%d processes, %ld rounds, %s\n", g_nProc, g_rounds,
+    g_pinEvents ? "with pintool event counting" : "no pintool event counting");
+  printf("Layout sizes: legacy %zu + %d*%zu bytes, current %zu + %d*%zu bytes\n",
+    sizeof(legacyData_t), g_nProc, sizeof(legacyProcData_t),
+    sizeof(plrData_t), g_nProc, sizeof(perProcData_t));
+  
+  double legacyNs = 0, currentNs = 0;
+  layoutFields_t fields;
+  if (!onlyLayout || strcmp(onlyLayout, "legacy") == 0) {
+    getLegacyFields(&fields);
+    legacyNs = runLayout(&fields);
+  }
+  if (!onlyLayout || strcmp(onlyLayout, "current") == 0) {
+    getCurrentFields(&fields);
+    currentNs = runLayout(&fields);
+  }
+  if (legacyNs > 0 && currentNs > 0) {
+    printf("current/legacy: %.2f\n", currentNs / legacyNs);
+  }
+  
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void *mapLayout(size_t size) {
+  // Page aligned, like the mmap of the real shm file
+  void *area = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (area == MAP_FAILED) {
+    perror("mmap");
+    exit(1);
+  }
+  return area;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void getLegacyFields(layoutFields_t *fields) {
+  legacyData_t *data = mapLayout(sizeof(legacyData_t) + g_nProc*sizeof(legacyProcData_t));
+  legacyProcData_t *procs = (legacyProcData_t*)(data+1);
+  
+  fields->name = "legacy";
+  fields->condWaitCnt = &data->condWaitCnt[0];
+  fields->barrierGen = &data->barrierGen;
+  fields->eventCount = &data->eventCount;
+  for (int i = 0; i < g_nProc; ++i) {
+    fields->insidePLR[i] = &procs[i].insidePLR;
+    fields->syscallArgs[i] = &procs[i].syscallArgs[0];
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void getCurrentFields(layoutFields_t *fields) {
+  plrData_t *data = mapLayout(sizeof(plrData_t) + g_nProc*sizeof(perProcData_t));
+  perProcData_t *procs = (perProcData_t*)(data+1);
+  
+  fields->name = "current";
+  fields->condWaitCnt = &data->condWaitCnt[0];
+  fields->barrierGen = &data->barrierGen;
+  fields->eventCount = &data->eventCount;
+  for (int i = 0; i < g_nProc; ++i) {
+    fields->insidePLR[i] = &procs[i].insidePLR;
+    fields->syscallArgs[i] = &procs[i].syscallArgs[0];
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Returns the average time per round in nanoseconds
+static double runLayout(const layoutFields_t *fields) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  
+  for (int i = 0; i < g_nProc; ++i) {
+    int pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      exit(1);
+    } else if (pid == 0) {
+      runProcess(fields, i);
+      _exit(0);
+    }
+  }
+  for (int i = 0; i < g_nProc; ++i) {
+    int status;
+    if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "Error: Benchmark process failed\n");
+      exit(1);
+    }
+  }
+  
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double ns = (end.tv_sec - start.tv_sec)*1e9 + (end.tv_nsec - start.tv_nsec);
+  ns /= g_rounds;
+  printf("%-8s %10.1f ns/round\n", fields->name, ns);
+  return ns;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void runProcess(const layoutFields_t *fields, int idx) {
+  // Spread the processes over the available cores, like separate replicas
+  cpu_set_t cpus;
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+    int nCpu = CPU_COUNT(&cpus);
+    int target = idx % nCpu;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &cpus) && target-- == 0) {
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        sched_setaffinity(0, sizeof(cpus), &cpus);
+        break;
+      }
+    }
+  }
+  
+  for (long round = 0; round < g_rounds; ++round) {
+    __atomic_store_n(fields->insidePLR[idx], 1, __ATOMIC_RELAXED);
+  
+    syscallArgs_t *args = fields->syscallArgs[idx];
+    args->addr = (void*)round;
+    for (int i = 0; i < 6; ++i) {
+      __atomic_store_n(&args->arg[i], round + i, __ATOMIC_RELAXED);
+    }
+    if (g_pinEvents) {
+      __atomic_add_fetch(fields->eventCount, 1, __ATOMIC_RELAXED);
+    }
+  
+    waitBarrier(fields);
+    __atomic_store_n(fields->insidePLR[idx], 0, __ATOMIC_RELAXED);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Same arrive/release protocol as the futex barrier, minus the sleeping
+static void waitBarrier(const layoutFields_t *fields) {
+  unsigned int gen = __atomic_load_n(fields->barrierGen, __ATOMIC_ACQUIRE);
+  if (__atomic_add_fetch(fields->condWaitCnt, 1, __ATOMIC_ACQ_REL) == g_nProc) {
+    __atomic_store_n(fields->condWaitCnt, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(fields->barrierGen, gen+1, __ATOMIC_RELEASE);
+    return;
+  }
+  
+  int polls = 0;
+  while (__atomic_load_n(fields->barrierGen, __ATOMIC_ACQUIRE) == gen) {
+    // Yield now and then, in case there are fewer cores than processes
+    if (++polls % 256 == 0) {
+      sched_yield();
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static long parseLong(const char *str, const char *optName) {
+  char *endptr;
+  errno = 0;
+  long val = strtol(str, &endptr, 10);
+  if (endptr == str || *endptr != '\0' || errno == ERANGE) {
+    fprintf(stderr, "Error: %s ('%s') is not an integer value\n", optName, str);
+    exit(1);
+  }
+  return val;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void printUsage() {
+  printf("\n"
+    "Usage: shmLayoutBench [OPTIONS]\n"
+    "Options:\n"
+    "  -h             Print this help and exit\n"
+    "  -n <int>       Number of processes (default=3)\n"
+    "  -r <long>      Barrier rounds per layout (default=200000)\n"
+    "  -p             Also count a fault injection pintool event every round\n"
+    "  -l <layout>    Only run the \"legacy\" or \"current\" layout\n");
+}
@@ -0,0 +1,17 @@
+#include "futexUtil.h"
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+int futex_wait(int *addr, int val, const struct timespec *relTimeout) {
+  return syscall(SYS_futex, addr, FUTEX_WAIT, val, relTimeout, NULL, 0);
+}
+
+int futex_wait_abs(int *addr, int val, const struct timespec *absTimeout) {
+  // FUTEX_WAIT takes a relative timeout, only FUTEX_WAIT_BITSET an absolute one
+  return syscall(SYS_futex, addr, FUTEX_WAIT_BITSET, val, absTimeout, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+int futex_wake(int *addr, int nWake) {
+  return syscall(SYS_futex, addr, FUTEX_WAKE, nWake, NULL, NULL, 0);
+}
@@ -0,0 +1,29 @@
+#ifndef FUTEX_UTIL_H
+#define FUTEX_UTIL_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <time.h>
+
+// Thin wrappers around the raw futex syscall. The futex words are expected
+// to live in memory shared between processes, so the non-private futex
+// operations are used.
+
+// Sleep while *addr == val, for at most relTimeout (or forever if NULL).
+// Returns 0 when woken, or -1 with errno set (EAGAIN if *addr != val,
+// ETIMEDOUT if the timeout expired, EINTR if interrupted by a signal).
+int futex_wait(int *addr, int val, const struct timespec *relTimeout);
+
+// Same as futex_wait, but sleeps until the absolute CLOCK_MONOTONIC time
+// absTimeout at most, so repeated waits can share a single deadline.
+int futex_wait_abs(int *addr, int val, const struct timespec *absTimeout);
+
+// Wake up to nWake processes sleeping on addr.
+// Returns the number of processes woken, or -1 with errno set.
+int futex_wake(int *addr, int nWake);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
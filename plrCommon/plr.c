@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,6 +9,15 @@
 #include <unistd.h>
 #include <sys/prctl.h>
 #include <string.h>
+#include <sched.h>
+#include <dlfcn.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <limits.h>
 
 #include "plr.h"
 #include "plrLog.h"
@@ -15,12 +25,102 @@
 #include "plrCompare.h"
 #include "timeUtil.h"
 #include "pthreadUtil.h"
+#include "futexUtil.h"
+#include "plrRecord.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // Global data
 
 static int g_insidePLRInternal = 0;
 
+// Set between plr_pause() & plr_resume() of the program, see plr_setPaused
+static int g_paused = 0;
+
+// Hash of checks passed to plr_deferSyscallArgsCheck since the last
+// published syscall arguments
+static unsigned long g_deferredHash = 0;
+// Calls folded into g_deferredHash by plr_foldSyscallArgs since then
+static int g_epochCalls = 0;
+
+// Action & argument index for the barrier action of plr_checkedMasterAction,
+// only used by the master process when running that action
+static int (*g_checkedActionPtr)(void) = NULL;
+static int g_checkedArgsIdx = 0;
+
+// Action of the current plr_masterAction or plr_executorAction call, and
+// whether this process ran the action of the last such call
+static int (*g_actionPtr)(void) = NULL;
+static int g_executedAction = 0;
+
+// Quorum mode state. g_quorumBarrier is set while waiting in a barrier that
+// may be released by a quorum. g_quorumLateIdx is the barrier index this
+// process last arrived late at, and g_quorumCatchUpIdx is set from it until
+// the process reaches its next barrier, which is when it's done with the
+// results of the barrier it was late for.
+static int g_quorumBarrier = 0;
+static int g_quorumLateIdx = -1;
+static int g_quorumCatchUpIdx = -1;
+
+// Asynchronous mode state. g_asyncEntry is the ring entry that
+// plr_copyToShm & plr_copyFromShm access the results of, set while the
+// master runs an action and while a slave uses the results of an entry.
+// g_asyncHolding is set from when a slave took an entry until its next
+// checked syscall, when it's done with the results.
+static asyncEntry_t *g_asyncEntry = NULL;
+static int g_asyncHolding = 0;
+
+// Record & verify mode state. g_logRecording is set while the recording
+// process runs an action, & g_logDataLen is how much of extraShm it wrote
+// results to. g_logRecord is the record a verifying process reads results
+// from, & g_logOffset is where the next record starts. Checkpointing logs
+// & replays calls the same way.
+static int g_logRecording = 0;
+static unsigned long g_logDataLen = 0;
+static const plrRecord_t *g_logRecord = NULL;
+static unsigned long g_logOffset = PLR_RECORD_FIRST_OFFSET;
+
+// Checkpointing state. g_ckptCalls counts the checked syscalls of this
+// process, the same in every process. g_replayEnd is set while replaying
+// the logged calls after a rollback, up to that offset of the log.
+// g_ckptRecord is set while a checked action runs in a separate barrier
+// after a repair, so that its executor logs the call like the barrier
+// action of a clean check does.
+static unsigned long g_ckptCalls = 0;
+static unsigned long g_replayEnd = 0;
+static int g_ckptRecord = 0;
+
+// Entry of plrShm->watchdogStats for the call type of the last checked
+// syscall. Following barriers up to the next checked syscall, e.g. of the
+// action that goes with it, count towards the same call type.
+static int g_watchdogStatsIdx = 0;
+
+// Memory scrubbing state. The scrubbed ranges are split into chunks of
+// PLR_SCRUB_CHUNK_PAGES pages, & g_scrubDigests keeps the last hash of
+// each. g_scrubNRanges is -1 until the ranges were looked up.
+// g_scrubPid is the process the hashes were last updated in, a process
+// forked since hashes every chunk again since it may not have the
+// soft-dirty bits of its parent. g_scrubbing is set during a scrub, so
+// that its own checked syscall doesn't count towards the next one.
+#define PLR_SCRUB_CHUNK_PAGES 16
+#define PLR_SCRUB_MAX_RANGES 16
+typedef struct {
+  unsigned long start;
+  unsigned long end;
+} scrubRange_t;
+static scrubRange_t g_scrubRanges[PLR_SCRUB_MAX_RANGES];
+static int g_scrubNRanges = -1;
+static unsigned long g_scrubNChunks = 0;
+static unsigned long *g_scrubDigests = NULL;
+static uint64_t *g_scrubPagemap = NULL;
+static int g_scrubSoftDirty = 0;
+static int g_scrubPid = 0;
+static unsigned long g_scrubCalls = 0;
+static int g_scrubbing = 0;
+
+// Number of processes the master grows the group to when it starts its next
+// checked syscall, 0 if the group isn't growing. See plr_adaptGrow.
+static int g_adaptGrowTo = 0;
+
 ///////////////////////////////////////////////////////////////////////////////
 // Private functions
 
@@ -29,6 +129,9 @@ static int g_insidePLRInternal = 0;
 // when it returns from this.
 int plr_forkNewProcess(perProcData_t *newProcShm);
 
+// Tell the figurehead that the calling process took its slot in allProcShm
+static void plr_notifyFigurehead();
+
 typedef enum {
   // Any process may perform the wait action
   WAIT_ACTION_ANY,
@@ -46,10 +149,233 @@ typedef enum {
 //     0 : Action completed, let all processes exit barrier
 //     1 : Rerun action on next sequential process
 // The wait action type determines which process will perform the wait action.
+// Dispatches to the barrier implementation selected by plrShm->barrierMode.
+// Returns < 0 on error, 0 once the barrier completed, or 1 if g_quorumBarrier
+// is set and a quorum of the other processes left the barrier without the
+// calling process (futex barrier only).
 int plr_waitBarrier(int (*actionPtr)(void), waitActionType_t actionType);
 
-// Barrier action function for plr_checkSyscallArgs()
-int plr_checkSyscallArgs_act();
+// plr_waitBarrier implementation using plrShm->lock & condition variables
+int plr_waitBarrierCond(int (*actionPtr)(void), waitActionType_t actionType);
+
+// plr_waitBarrier implementation using atomic arrival counters & futexes.
+// plrShm->lock is only taken to run the barrier action and to handle an
+// expired watchdog, never on the arrival/wakeup path.
+int plr_waitBarrierFutex(int (*actionPtr)(void), waitActionType_t actionType);
+
+// plr_waitBarrier implementation combining arrivals up a tree of processes
+// (allProcShm as a heap with fan-out PLR_TREE_FANOUT) and passing the release
+// back down it. Otherwise the same as the futex barrier, and shares its
+// helpers for running the action & handling the watchdog.
+int plr_waitBarrierTree(int (*actionPtr)(void), waitActionType_t actionType);
+
+// Number of tree children of each process in the tree barrier
+#define PLR_TREE_FANOUT 2
+
+// Helpers for plr_waitBarrierTree
+static int plr_treeSubtreeArrived(unsigned int gen);
+static void plr_treeWakeChildren();
+
+// Quorum mode helpers for plr_waitBarrierFutex
+#define PLR_QUORUM_CLOSED (1u << 31)
+#define PLR_QUORUM_MAX_PROC 31
+static int plr_quorumArrive(unsigned int gen, unsigned int *lateGen);
+static int plr_quorumTryRelease(unsigned int gen, waitActionType_t actionType);
+static void plr_quorumWaitLate(unsigned int lateGen);
+static int plr_quorumStragglerFaulted(unsigned int gen);
+
+// Helpers for plr_waitBarrierFutex & plr_waitBarrierTree
+static int plr_futexClaimBarrier(unsigned int gen);
+static int plr_futexDispatchAction(int (*actionPtr)(void), waitActionType_t actionType, unsigned int gen);
+static int plr_futexRunAction(int (*actionPtr)(void), unsigned int gen);
+static void plr_futexHandoffAction(int idx);
+static void plr_futexCompleteBarrier(unsigned int gen);
+static void plr_futexWakeProc(perProcData_t *procShm);
+
+// Watchdog deadline of barrier generation gen, shared by all processes.
+// plr_armWatchdog sets it to a full watchdog interval from now.
+// plr_watchdogDeadline returns it as an absolute CLOCK_MONOTONIC time, or a
+// full interval from now if the first process to arrive hasn't armed it yet.
+static void plr_armWatchdog(unsigned int gen);
+static struct timespec plr_watchdogDeadline(unsigned int gen);
+
+// Adaptive watchdog. The last process to arrive at barrier generation gen
+// records the skew since the watchdog was armed with
+// plr_recordArrivalSkew, which also relearns the call type's timeout.
+// plr_watchdogTimeoutMs returns the timeout of the current call type.
+#define PLR_WATCHDOG_MIN_SAMPLES 32
+#define PLR_WATCHDOG_MAX_SAMPLES 4096
+static void plr_setWatchdogCallType(void *addr);
+static void plr_recordArrivalSkew(unsigned int gen);
+static long plr_watchdogTimeoutMs();
+static long long plr_skewPercentileUs(const watchdogStats_t *stats);
+
+// Returns 1 if the only process missing from the barrier with index waitIdx
+// was flagged dead by the figurehead. plr_replaceWithoutWatchdog also covers
+// a faulted quorum straggler. Either way the missing process can be replaced
+// right away, without waiting for the watchdog to expire.
+static int plr_deadProcessMissing(int waitIdx);
+static int plr_replaceWithoutWatchdog(unsigned int gen);
+
+// Spin-then-park support. Polls condFn(ctx) with pause & exponential backoff
+// until it returns nonzero or plrShm->spinBudgetUs runs out.
+// Returns 1 if the condition became true while spinning, 0 otherwise.
+static int plr_spinUntil(int (*condFn)(void *), void *ctx);
+
+// plr_spinUntil conditions for the cond & futex barriers
+typedef struct {
+  int waitIdx;
+  int waitCnt;
+} condSpinCtx_t;
+static int plr_condBarrierProgressed(void *ctx);
+typedef struct {
+  int futexVal;
+} futexSpinCtx_t;
+static int plr_futexWordChanged(void *ctx);
+
+// Copy syscall arguments & deferred check hash to this process's shared
+// memory area before a barrier. Returns the index they were stored at.
+int plr_publishSyscallArgs(const syscallArgs_t *args);
+
+// Common implementation of plr_masterAction() and plr_executorAction(),
+// actionType selects which process runs the action
+int plr_runAction(int (*actionPtr)(void), waitActionType_t actionType);
+int plr_runAction_act();
+
+// Common implementation of plr_checkedMasterAction() and
+// plr_checkedExecutorAction()
+int plr_checkedAction(const syscallArgs_t *args, int (*actionPtr)(void), waitActionType_t actionType);
+// Called instead of voting by a process that arrived after a quorum already
+// ran the checked action. Compares this process's arguments against those
+// of the quorum, and waits to be replaced if they disagree.
+int plr_checkQuorumVerdict(const syscallArgs_t *args, int argsIdx);
+
+// Asynchronous mode replacement for plr_checkedAction & plr_checkSyscallArgs
+// (actionPtr NULL). The master publishes each checked syscall & the results
+// of its action in the ring and continues, while each slave checks its own
+// arguments against the entry & uses its results, up to plrShm->asyncLag
+// entries behind. plr_asyncMasterAction & plr_asyncSlaveAction return 1 if
+// the calling process was just forked to replace a process of the other
+// kind, and has to take the other path.
+// The results of entries are kept in extraShm one after the other, and
+// the master waits for the slaves to catch up & starts over at the start
+// once they take up more than PLR_ASYNC_DATA_LIMIT bytes.
+#define PLR_ASYNC_DATA_LIMIT (4 << 20)
+int plr_asyncCheckedAction(const syscallArgs_t *args, int (*actionPtr)(void));
+static int plr_asyncMasterAction(const syscallArgs_t *args, int (*actionPtr)(void));
+static int plr_asyncSlaveAction(const syscallArgs_t *args);
+
+// Asynchronous mode waits, all with a watchdog timeout that restarts
+// whenever the process waited for makes progress. The master waits for
+// room in the ring & replaces slaves that fall behind for too long or that
+// voted themselves faulted. A slave waits for the next entry & replaces the
+// master if it stops publishing. A slave whose arguments disagree with the
+// master's waits for the other slave to settle who is faulted.
+// Return 1 in a replacement process, 0 otherwise.
+static int plr_asyncWaitSpace(unsigned long seq);
+static int plr_asyncWaitEntry(unsigned long seq);
+static int plr_asyncResolveDivergence(const syscallArgs_t *args, unsigned long seq);
+
+// Asynchronous mode helpers. plr_asyncWakeWaiters wakes the processes that
+// wait for another one to make progress. plr_asyncPark sleeps on the futex
+// word until woken or the deadline passes, returning 1 on timeout.
+// plr_asyncReplace replaces the process at idx, if it still is expectPid,
+// with a copy of the calling process that continues at entry seq. It
+// returns 1 in the replacement process.
+static void plr_asyncWakeWaiters();
+static int plr_asyncPark(int futexVal, const struct timespec *deadline);
+static struct timespec plr_asyncDeadline();
+static int plr_asyncReplace(int idx, unsigned long seq, int expectPid);
+
+// Record & verify mode replacement for plr_checkedAction &
+// plr_checkSyscallArgs. The recording process runs the action & appends the
+// call with its results to the log. A verifying process checks the call
+// against the next record & uses its results. plr_verifyDiverged reports
+// a call that doesn't match the log & exits.
+static int plr_logCheckedAction(const syscallArgs_t *args, int (*actionPtr)(void));
+static void plr_verifyDiverged(const char *reason, int faultVal);
+// Aborts the whole group after a fault that can't be corrected, see
+// plr_figureheadFaultDetected, or rolls it back to a checkpoint
+static void plr_abortGroup() __attribute__((noreturn));
+// Checkpointing. plr_ckptTake is called by every process at the start of
+// the checked syscall plrShm->ckptAtCall, flushes the master's buffered
+// output in a barrier & forks the master as a checkpoint. It returns in all
+// of them, and returns again in the checkpoint once plr_ckptRollback killed the group &
+// resumed it in its place, which is how plr_ckptRollback returns only if
+// there's no checkpoint left. plr_ckptLogCall is run by the executor of a
+// verified call to log it, and plr_replayCheckedAction replaces
+// plr_checkedAction while replaying the logged calls.
+static void plr_ckptTake();
+static int plr_ckptFlushAct();
+static void plr_ckptResume(ckptEntry_t *entry, perProcData_t *slotCopy);
+static void plr_ckptRollback();
+static void plr_ckptLogCall(int argsIdx);
+static int plr_replayCheckedAction(const syscallArgs_t *args);
+// Kills pid & waits until it's gone, so it can't touch the shared data
+static void plr_killAndWait(int pid);
+// Memory scrubbing. plr_scrubMemory is called at the start of every
+// plrShm->scrubInterval-th checked syscall by plr_beginCheckedCall, updates the hashes of the
+// chunks written since the last scrub & checks their combined hash.
+// plr_scrubInit looks up the scrubbed ranges & whether the kernel tracks
+// soft-dirty bits, plr_scrubFindDirty marks the chunks with a page written
+// since the last scrub in dirty (one entry per chunk) & restarts tracking.
+static void plr_scrubMemory();
+static int plr_scrubInit();
+static int plr_scrubFindDirty(char *dirty);
+static int plr_scrubClearSoftDirty();
+// Adaptive redundancy. plr_adaptDecide is run by the barrier action of the
+// checked action functions, with all processes arrived & plrShm->lock held,
+// and returns the number of processes to resize the group to (0 to keep
+// it). Every process calls plr_adaptResize with it after the barrier. A
+// shrink happens right away, while the master only grows the group with
+// plr_adaptGrow once it starts its next checked syscall (see
+// plr_beginCheckedCall), so that the new processes don't copy the effects
+// of the action it just ran.
+// plr_adaptNoteFault is called with plrShm->lock held whenever a faulted
+// process was replaced.
+static int plr_adaptDecide();
+static void plr_adaptResize(int nProc);
+static void plr_adaptGrow();
+static void plr_adaptNoteFault();
+// Limit of the growth of the clean period while faults keep coming
+#define PLR_ADAPT_MAX_BACKOFF 64
+
+// Where plr_copyToShm & plr_copyFromShm & their checked variants copy length
+// bytes at offset to or from. plr_shmDest makes room in extraShm for them
+// first, plr_shmSource reads from the log record when there is one.
+static char *plr_shmDest(size_t length, size_t offset);
+static const char *plr_shmSource(size_t length, size_t offset);
+
+// Returns 1 if the arguments two processes published at argsIdx agree,
+// comparing their hashes first
+static int plr_sameProcArgs(int idx1, int idx2, int argsIdx, const unsigned long *hashes);
+
+// Barrier action for plr_checkedAction()
+int plr_checkedAction_act();
+
+// Run by every process at the start of each checked syscall, whichever way
+// it's checked, before it runs anything for it. Grows the group if the
+// master has to, & scrubs memory every plrShm->scrubInterval-th call.
+static void plr_beginCheckedCall();
+
+// Compare the syscall arguments every process published in
+// syscallArgs[argsIdx] and find the majority, in time linear in nProc.
+// Return value:
+//           -1 : All arguments agree
+//   0..nProc-1 : Lowest index of the majority, the processes that disagree
+//                with it are faulted
+//        nProc : No majority, unrecoverable
+int plr_voteSyscallArgs(int argsIdx);
+
+// Compare the syscall arguments & deferred check hash published by two
+// processes at argsIdx. Returns 0 if identical, >= 1 if different.
+int plr_compareProcArgs(int idx1, int idx2, int argsIdx);
+
+// Handle the faulted processes found by plr_voteSyscallArgs, given the
+// majority index it returned. Called by every process after voting: the
+// faulted processes wait to be killed, the lowest indexed good process
+// replaces all of them in one pass, and the others continue.
+int plr_repairFaultedProcs(int goodProc, int argsIdx);
 
 // Handle expired watchdog timer during plr_waitBarrier
 int plr_watchdogExpired();
@@ -73,7 +399,7 @@ void plr_refreshSharedData() {
   // Check that myProcShm is set properly
   int myPid = getpid();
   if (myProcShm == NULL || myProcShm->pid != myPid) {
-    for (int i = 0; i < plrShm->nProc; ++i) {
+    for (int i = 0; i < plrShm->maxProc; ++i) {
       if (allProcShm[i].pid == myPid) {
         myProcShm = &allProcShm[i];
         break;
@@ -101,14 +427,26 @@ int plr_figureheadInit(int nProc, int pintoolMode, int pid, long watchdogTimeout
     return -1;
   }
   plrShm->figureheadPid = pid;
+  plrShm->appPid = pid;
   plrShm->insidePLRInitTrue = pintoolMode;
   plrShm->watchdogTimeout = watchdogTimeoutMs;
+  for (int cls = 0; cls < PLR_HASH_NCLASSES; ++cls) {
+    plrShm->hashAlgo[cls] = plrH_defaultAlgo(cls);
+  }
+  plrlog(LOG_DEBUG, "PLR: Hashing crc32c with %s, xxh with %s\n",
+    plrH_implName(PLR_HASH_CRC32C), plrH_implName(PLR_HASH_XXH));
   return 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 int plr_figureheadExit() {
+  plrlog(LOG_DEBUG, "PLR: %lu barrier wakeups, %lu spurious\n",
+    __atomic_load_n(&plrShm->barrierWakeups, __ATOMIC_RELAXED),
+    __atomic_load_n(&plrShm->spuriousWakeups, __ATOMIC_RELAXED));
+  if (plrShm->ckptIntervalMs && unlink(plrShm->logPath) < 0) {
+    perror("unlink");
+  }
   if (plrSD_cleanupSharedData() < 0) {
     plrlog(LOG_ERROR, "Error: PLR shared data cleanup failed\n");
     return -1;
@@ -118,6 +456,430 @@ int plr_figureheadExit() {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+int plr_figureheadSetBarrierMode(plrBarrierMode_t mode) {
+  if (mode != PLR_BARRIER_COND && mode != PLR_BARRIER_FUTEX && mode != PLR_BARRIER_TREE) {
+    plrlog(LOG_ERROR, "Error: Invalid barrier mode %d\n", mode);
+    return -1;
+  }
+  plrShm->barrierMode = mode;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetSpinBudget(long spinBudgetUs) {
+  if (spinBudgetUs < 0) {
+    plrlog(LOG_ERROR, "Error: Invalid spin budget %ld us\n", spinBudgetUs);
+    return -1;
+  }
+  if (spinBudgetUs > plrShm->watchdogTimeout*1000) {
+    spinBudgetUs = plrShm->watchdogTimeout*1000;
+  }
+  plrShm->spinBudgetUs = spinBudgetUs;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetQuorum(int enable) {
+  if (enable && plrShm->nProc < 3) {
+    plrlog(LOG_ERROR, "Error: Quorum mode requires at least 3 processes\n");
+    return -1;
+  }
+  if (enable && plrShm->barrierMode != PLR_BARRIER_FUTEX) {
+    plrlog(LOG_ERROR, "Error: Quorum mode requires the futex barrier\n");
+    return -1;
+  }
+  if (enable && plrShm->nProc > PLR_QUORUM_MAX_PROC) {
+    plrlog(LOG_ERROR, "Error: Quorum mode supports at most %d processes\n", PLR_QUORUM_MAX_PROC);
+    return -1;
+  }
+  plrShm->quorum = enable;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetAsyncLag(int lag) {
+  if (lag < 0 || lag > PLR_ASYNC_MAX_LAG) {
+    plrlog(LOG_ERROR, "Error: Asynchronous mode lag must be between 0 (off) and %d entries\n", PLR_ASYNC_MAX_LAG);
+    return -1;
+  }
+  if (lag && plrShm->nProc != 3) {
+    plrlog(LOG_ERROR, "Error: Asynchronous mode requires 3 redundant processes\n");
+    return -1;
+  }
+  if (lag && plrShm->quorum) {
+    plrlog(LOG_ERROR, "Error: Asynchronous mode can't be combined with quorum mode\n");
+    return -1;
+  }
+  plrShm->asyncLag = lag;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetEpochLength(int calls) {
+  if (calls < 0) {
+    plrlog(LOG_ERROR, "Error: Epoch length can't be negative\n");
+    return -1;
+  }
+  plrShm->epochLength = calls;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetOutputBatching(long limitBytes) {
+  if (limitBytes < 0) {
+    plrlog(LOG_ERROR, "Error: Output batching limit can't be negative\n");
+    return -1;
+  }
+  plrShm->outputBatchLimit = limitBytes;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetCheckBudget(int percent) {
+  if (percent < 1 || percent > 100) {
+    plrlog(LOG_ERROR, "Error: plr_check budget must be between 1 and 100 percent\n");
+    return -1;
+  }
+  plrShm->checkBudgetPct = percent;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetHashAlgorithm(plrHashClass_t cls, plrHashAlgo_t algo) {
+  if (cls >= PLR_HASH_NCLASSES || algo >= PLR_HASH_NALGOS) {
+    plrlog(LOG_ERROR, "Error: Invalid hash class %d or algorithm %d\n", cls, algo);
+    return -1;
+  }
+  plrShm->hashAlgo[cls] = algo;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetAdaptiveRedundancy(long cleanMs) {
+  if (cleanMs <= 0) {
+    plrlog(LOG_ERROR, "Error: Invalid adaptive redundancy clean period %ld ms\n", cleanMs);
+    return -1;
+  }
+  if (plrShm->maxProc <= PLR_ADAPT_MIN_PROC) {
+    plrlog(LOG_ERROR, "Error: Adaptive redundancy needs more than %d processes\n", PLR_ADAPT_MIN_PROC);
+    return -1;
+  }
+  // The tree barrier's topology, the quorum's majority & the asynchronous
+  // ring all assume a fixed group
+  if (plrShm->barrierMode == PLR_BARRIER_TREE || plrShm->quorum || plrShm->asyncLag || plrShm->logMode != PLR_LOG_OFF) {
+    plrlog(LOG_ERROR, "Error: Adaptive redundancy can't be combined with the tree barrier, quorum, asynchronous, record or verify mode\n");
+    return -1;
+  }
+  
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  plrShm->adaptCleanMs = cleanMs;
+  plrShm->adaptHoldMs = cleanMs;
+  plrShm->adaptLastEventNs = tspecToNs(now);
+  plrShm->nProc = PLR_ADAPT_MIN_PROC;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetScrubbing(int interval) {
+  if (interval < 0) {
+    plrlog(LOG_ERROR, "Error: Invalid scrub interval %d\n", interval);
+    return -1;
+  }
+  // The scrubs would be checked syscalls the log doesn't know about
+  if (interval && plrShm->logMode != PLR_LOG_OFF) {
+    plrlog(LOG_ERROR, "Error: Memory scrubbing can't be combined with record or verify mode\n");
+    return -1;
+  }
+  plrShm->scrubInterval = interval;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetCheckpointing(long intervalMs, int retain) {
+  if (intervalMs <= 0) {
+    plrlog(LOG_ERROR, "Error: Invalid checkpoint interval %ld ms\n", intervalMs);
+    return -1;
+  }
+  if (retain < 1 || retain > PLR_CKPT_MAX_RETAIN) {
+    plrlog(LOG_ERROR, "Error: Between 1 and %d checkpoints can be kept\n", PLR_CKPT_MAX_RETAIN);
+    return -1;
+  }
+  // Late quorum processes & the asynchronous ring let processes run past
+  // calls that weren't verified yet, & record & verify mode have a log
+  if (plrShm->quorum || plrShm->asyncLag || plrShm->logMode != PLR_LOG_OFF) {
+    plrlog(LOG_ERROR, "Error: Checkpointing can't be combined with quorum, asynchronous, record or verify mode\n");
+    return -1;
+  }
+  
+  // The calls to replay are logged to a file that lives next to the shared
+  // data area, & is removed along with it
+  int w = snprintf(plrShm->logPath, sizeof(plrShm->logPath), "/dev/shm/plr_ckpt.%d", plrShm->figureheadPid);
+  if (w < 0 || w >= (int)sizeof(plrShm->logPath)) {
+    return -1;
+  }
+  plrRecordHeader_t header = {
+    .magic = PLR_RECORD_MAGIC,
+    .version = PLR_RECORD_VERSION,
+    .appPid = plrShm->appPid,
+    .epochLength = plrShm->epochLength,
+    .outputBatchLimit = plrShm->outputBatchLimit,
+  };
+  memcpy(header.hashAlgo, plrShm->hashAlgo, sizeof(header.hashAlgo));
+  if (plrRec_create(plrShm->logPath, &header) < 0) {
+    plrlog(LOG_ERROR, "Error: Creating checkpoint log %s failed\n", plrShm->logPath);
+    return -1;
+  }
+  plrShm->logEnd = PLR_RECORD_FIRST_OFFSET;
+  plrShm->logRecords = 0;
+  plrShm->ckptIntervalMs = intervalMs;
+  plrShm->ckptRetain = retain;
+  // The first checkpoint is taken at the first checked syscall, so that
+  // there always is one to roll back to
+  plrShm->ckptAtCall = 1;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetRecordLog(const char *path) {
+  if (plrShm->nProc != 1) {
+    plrlog(LOG_ERROR, "Error: Record mode runs a single process\n");
+    return -1;
+  }
+  
+  // Settings that change which calls get checked go along in the header
+  plrRecordHeader_t header = {
+    .magic = PLR_RECORD_MAGIC,
+    .version = PLR_RECORD_VERSION,
+    .appPid = plrShm->appPid,
+    .epochLength = plrShm->epochLength,
+    .outputBatchLimit = plrShm->outputBatchLimit,
+  };
+  memcpy(header.hashAlgo, plrShm->hashAlgo, sizeof(header.hashAlgo));
+  if (plrRec_create(path, &header) < 0) {
+    plrlog(LOG_ERROR, "Error: Creating call log %s failed\n", path);
+    return -1;
+  }
+  // The program may change its working directory
+  if (realpath(path, plrShm->logPath) == NULL) {
+    perror("realpath");
+    return -1;
+  }
+  plrShm->logEnd = PLR_RECORD_FIRST_OFFSET;
+  plrShm->logRecords = 0;
+  plrShm->logMode = PLR_LOG_RECORD;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetVerifyLog(const char *path) {
+  if (plrShm->asyncLag) {
+    plrlog(LOG_ERROR, "Error: Verify mode can't be combined with asynchronous mode\n");
+    return -1;
+  }
+  
+  plrRecordHeader_t header;
+  if (plrRec_readHeader(path, &header) < 0) {
+    return -1;
+  }
+  if (realpath(path, plrShm->logPath) == NULL) {
+    perror("realpath");
+    return -1;
+  }
+  plrShm->appPid = header.appPid;
+  plrShm->epochLength = header.epochLength;
+  plrShm->outputBatchLimit = header.outputBatchLimit;
+  memcpy(plrShm->hashAlgo, header.hashAlgo, sizeof(plrShm->hashAlgo));
+  plrShm->logRecords = header.nRecords;
+  plrShm->logMode = PLR_LOG_VERIFY;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadFinishLog() {
+  if (plrShm->logMode == PLR_LOG_RECORD) {
+    if (plrRec_finish(plrShm->logPath, plrShm->logRecords, plrShm->logEnd) < 0) {
+      plrlog(LOG_ERROR, "Error: Finishing call log %s failed\n", plrShm->logPath);
+      return -1;
+    }
+    plrlog(LOG_DEBUG, "PLR: Recorded %lu calls\n", plrShm->logRecords);
+  } else if (plrShm->logMode == PLR_LOG_VERIFY) {
+    int nDiverged = 0;
+    for (int i = 0; i < plrShm->nProc; ++i) {
+      perProcData_t *procShm = &allProcShm[i];
+      if (procShm->verifyDiverged) {
+        plrlog(LOG_ERROR, "PLR: Verifier %d diverged from the log at call %lu\n", i, procShm->verifyDiverged-1);
+        ++nDiverged;
+      } else if (procShm->verifyRecords != plrShm->logRecords) {
+        plrlog(LOG_ERROR, "PLR: Verifier %d stopped after %lu of %lu calls\n", i, procShm->verifyRecords, plrShm->logRecords);
+        ++nDiverged;
+      }
+    }
+    if (nDiverged > 0) {
+      return 1;
+    }
+    plrlog(LOG_DEBUG, "PLR: %d verifiers agree with all %lu calls of the log\n", plrShm->nProc, plrShm->logRecords);
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadSetAdaptiveWatchdog(int percentile, int multiple, long minTimeoutMs) {
+  if (percentile < 1 || percentile > 100) {
+    plrlog(LOG_ERROR, "Error: Invalid adaptive watchdog percentile %d\n", percentile);
+    return -1;
+  }
+  if (multiple < 1) {
+    plrlog(LOG_ERROR, "Error: Invalid adaptive watchdog multiple %d\n", multiple);
+    return -1;
+  }
+  if (minTimeoutMs < 1 || minTimeoutMs > plrShm->watchdogTimeout) {
+    plrlog(LOG_ERROR, "Error: Adaptive watchdog minimum must be between 1 and %ld ms\n", plrShm->watchdogTimeout);
+    return -1;
+  }
+  plrShm->watchdogPercentile = percentile;
+  plrShm->watchdogMultiple = multiple;
+  plrShm->watchdogMinTimeout = minTimeoutMs;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadWriteWatchdogStats(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    plrlog(LOG_ERROR, "Error: Failed to open watchdog stats file %s\n", path);
+    return -1;
+  }
+  
+  // Call types are libc offsets, resolved against the figurehead's own libc
+  Dl_info libcInfo;
+  int haveLibc = dladdr((void*)&fopen, &libcInfo);
+  
+  fprintf(file, "# call samples p%d_skew_us timeout_ms skew_hist_log2_us\n", plrShm->watchdogPercentile);
+  for (int i = 0; i < PLR_WATCHDOG_CALL_TYPES; ++i) {
+    watchdogStats_t *stats = &plrShm->watchdogStats[i];
+    if (stats->samples == 0) {
+      continue;
+    }
+    
+    char name[64];
+    Dl_info funcInfo;
+    if (stats->addr == NULL) {
+      snprintf(name, sizeof(name), "(unchecked)");
+    } else if (haveLibc && dladdr((char*)libcInfo.dli_fbase + (unsigned long)stats->addr, &funcInfo)
+               && funcInfo.dli_sname) {
+      snprintf(name, sizeof(name), "%s", funcInfo.dli_sname);
+    } else {
+      snprintf(name, sizeof(name), "libc+%p", stats->addr);
+    }
+    
+    long timeoutMs = stats->timeoutMs ? stats->timeoutMs : plrShm->watchdogTimeout;
+    fprintf(file, "%s %u %lld %ld", name, stats->samples, plr_skewPercentileUs(stats), timeoutMs);
+    for (int j = 0; j < PLR_WATCHDOG_SKEW_BUCKETS; ++j) {
+      fprintf(file, " %u", stats->skewHist[j]);
+    }
+    fprintf(file, "\n");
+  }
+  
+  fclose(file);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadFaultDetected() {
+  return __atomic_load_n(&plrShm->faultDetected, __ATOMIC_ACQUIRE);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadGetProcPids(int *pids, int maxProc) {
+  for (int i = 0; i < plrShm->maxProc && i < maxProc; ++i) {
+    pids[i] = __atomic_load_n(&allProcShm[i].pid, __ATOMIC_ACQUIRE);
+  }
+  return plrShm->maxProc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_figureheadProcessDied(int pid) {
+  // The lock keeps the slot from being freed & taken by a replacement
+  // process between finding and flagging it, e.g. when the process was
+  // killed by plr_replaceProcessIdx. Don't wait on it forever in case the
+  // process died holding it.
+  struct timespec absWait;
+  clock_gettime(CLOCK_REALTIME, &absWait);
+  absWait = tspecAddMs(absWait, plrShm->watchdogTimeout);
+  int ret = pthread_mutex_timedlock(&plrShm->lock, &absWait);
+  if (ret != 0) {
+    plrlog(LOG_ERROR, "PLR: Error: Failed to lock shared data for dead pid %d (%d)\n", pid, ret);
+    return -1;
+  }
+  
+  int flagged = 0;
+  for (int i = 0; i < plrShm->maxProc; ++i) {
+    if (allProcShm[i].pid == pid && !allProcShm[i].died) {
+      plrlog(LOG_DEBUG, "PLR: Redundant process %d died\n", pid);
+      __atomic_store_n(&allProcShm[i].died, 1, __ATOMIC_SEQ_CST);
+      flagged = 1;
+      break;
+    }
+  }
+  
+  // Wake everyone up to notice. Cond barrier waiters are signaled with the
+  // lock held, so the wakeup can't be lost, and futex waiters check the
+  // flag after reading their futex word.
+  if (flagged) {
+    for (int i = 0; i < plrShm->nProc; ++i) {
+      if (allProcShm[i].pid == 0 || allProcShm[i].died) {
+        continue;
+      }
+      if (plrShm->barrierMode == PLR_BARRIER_COND) {
+        pthread_cond_signal(&allProcShm[i].cond[0]);
+        pthread_cond_signal(&allProcShm[i].cond[1]);
+      }
+      // Asynchronous mode waits use the futex word in any barrier mode
+      if (plrShm->barrierMode != PLR_BARRIER_COND || plrShm->asyncLag) {
+        plr_futexWakeProc(&allProcShm[i]);
+      }
+    }
+  }
+  
+  // Checkpoints outlive the process they were taken from. Once the whole
+  // group is gone, other than killed for a rollback, they're killed too.
+  if (plrShm->ckptIntervalMs && !plrShm->ckptRollback) {
+    int groupGone = 1;
+    for (int i = 0; i < plrShm->maxProc; ++i) {
+      if (allProcShm[i].pid != 0 && !allProcShm[i].died) {
+        groupGone = 0;
+      }
+    }
+    while (groupGone && plrShm->ckptTail < plrShm->ckptHead) {
+      kill(plrShm->ckpts[plrShm->ckptTail++ % PLR_CKPT_RING_SIZE].pid, SIGKILL);
+    }
+  }
+  
+  pthread_mutex_unlock(&plrShm->lock);
+  return flagged;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 int plr_processInit() {
   g_insidePLRInternal = 1;
   
@@ -145,6 +907,7 @@ int plr_processInit() {
   if (myProcShm == NULL && allProcShm[0].pid == 0) {
     myProcShm = &allProcShm[0];
     plrSD_initProcData(myProcShm);
+    plr_notifyFigurehead();
   }
   
   // Fork missing redundant processes and init their per-proc data areas
@@ -165,325 +928,2582 @@ int plr_processInit() {
       myProcShm = &allProcShm[i];
     }
   }
-  
-  plrShm->didProcessInit = 1;
-  g_insidePLRInternal = 0;
-  if (plrShm->insidePLRInitTrue) {
-    myProcShm->insidePLR = 1;
+  
+  plrShm->didProcessInit = 1;
+  g_insidePLRInternal = 0;
+  if (plrShm->insidePLRInitTrue) {
+    myProcShm->insidePLR = 1;
+  }
+  
+  pthread_mutex_unlock(&plrShm->lock);
+  
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_checkSyscallArgs(const syscallArgs_t *args) {
+  plr_beginCheckedCall();
+  if (plrShm->logMode != PLR_LOG_OFF) {
+    return plr_logCheckedAction(args, NULL);
+  } else if (plrShm->asyncLag) {
+    return plr_asyncCheckedAction(args, NULL);
+  } else if (plrShm->nProc == 2 || plrShm->adaptCleanMs || plrShm->ckptIntervalMs) {
+    // Detection only mode. The last process to arrive compares the pair of
+    // arguments once as the barrier action, instead of both voting after it.
+    // Adaptive redundancy also needs the barrier action to resize the group,
+    // & checkpointing to log the call.
+    return plr_checkedAction(args, NULL, WAIT_ACTION_ANY);
+  }
+  
+  int argsIdx = plr_publishSyscallArgs(args);
+  
+  // Wait for all processes to publish their arguments
+  if (plr_waitBarrier(NULL, WAIT_ACTION_ANY) < 0) {
+    plrlog(LOG_ERROR, "Error: plr_waitBarrier failed\n");
+    exit(1);
+  }
+  
+  // Every process votes on its own, without holding plrShm->lock. All
+  // processes read the same published arguments, so reach the same verdict.
+  int goodProc = plr_voteSyscallArgs(argsIdx);
+  if (goodProc == -1) {
+    // All arguments agree, nothing to do
+    return 0;
+  } else if (goodProc >= 0 && goodProc < plrShm->nProc) {
+    if (plr_repairFaultedProcs(goodProc, argsIdx) < 0) {
+      plrlog(LOG_ERROR, "Error: plr_repairFaultedProcs failed\n");
+      exit(1);
+    }
+    return 0;
+  } else {
+    // No majority
+    plrlog(LOG_ERROR, "[%d] Error: No processes agree with each other! Unrecoverable fault\n", getpid());
+    plr_abortGroup();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_publishSyscallArgs(const syscallArgs_t *args) {
+  // Arguments are double buffered by barrier index, since a process leaving
+  // a barrier may publish its next arguments while the others are still
+  // voting on the current ones
+  int argsIdx = __atomic_load_n(&plrShm->curWaitIdx, __ATOMIC_ACQUIRE);
+  memcpy(&myProcShm->syscallArgs[argsIdx], args, sizeof(syscallArgs_t));
+  if (plrShm->watchdogPercentile) {
+    plr_setWatchdogCallType(args->addr);
+  }
+  myProcShm->deferredHash[argsIdx] = g_deferredHash;
+  g_deferredHash = 0;
+  g_epochCalls = 0;
+  return argsIdx;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void plr_deferSyscallArgsCheck(const syscallArgs_t *args) {
+  g_deferredHash = plrC_hashArgs(g_deferredHash, args);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_foldSyscallArgs(const syscallArgs_t *args) {
+  // Every process folds the same calls, so they all reach the end of the
+  // epoch at the same call
+  if (plrShm->epochLength == 0 || ++g_epochCalls >= plrShm->epochLength) {
+    return plr_checkSyscallArgs(args);
+  }
+  plr_beginCheckedCall();
+  plr_deferSyscallArgsCheck(args);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_checkDeferredAtExit() {
+  syscallArgs_t args = {
+    .addr = PLR_ADDR_EXIT,
+  };
+  return plr_checkSyscallArgs(&args);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_epochLength() {
+  return plrShm->epochLength;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_checkedMasterAction(const syscallArgs_t *args, int (*actionPtr)(void)) {
+  plr_beginCheckedCall();
+  return plr_checkedAction(args, actionPtr, WAIT_ACTION_MASTER);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_checkedExecutorAction(const syscallArgs_t *args, int (*actionPtr)(void)) {
+  plr_beginCheckedCall();
+  return plr_checkedAction(args, actionPtr, WAIT_ACTION_ANY);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_checkedAction(const syscallArgs_t *args, int (*actionPtr)(void), waitActionType_t actionType) {
+  if (plrShm->logMode != PLR_LOG_OFF) {
+    return plr_logCheckedAction(args, actionPtr);
+  } else if (plrShm->asyncLag) {
+    // The master always runs the action in asynchronous mode
+    return plr_asyncCheckedAction(args, actionPtr);
+  }
+  
+  // Done with the results of the last replayed call
+  g_logRecord = NULL;
+  ++g_ckptCalls;
+  if (plrShm->ckptAtCall == g_ckptCalls && !g_replayEnd) {
+    // All earlier calls are verified & logged at this point
+    plr_ckptTake();
+  }
+  if (g_replayEnd) {
+    return plr_replayCheckedAction(args);
+  }
+  
+  int argsIdx = plr_publishSyscallArgs(args);
+  
+  // Wait for all processes to publish their arguments, then the process
+  // running the action votes and runs it if they all agree
+  g_checkedActionPtr = actionPtr;
+  g_checkedArgsIdx = argsIdx;
+  g_executedAction = 0;
+  g_quorumBarrier = plrShm->quorum;
+  int ret = plr_waitBarrier(&plr_checkedAction_act, actionType);
+  g_quorumBarrier = 0;
+  if (ret < 0) {
+    plrlog(LOG_ERROR, "Error: plr_waitBarrier failed\n");
+    exit(1);
+  } else if (ret == 1) {
+    // A quorum already ran the action without this process
+    return plr_checkQuorumVerdict(args, argsIdx);
+  }
+  if (plrShm->adaptResizeTo[argsIdx]) {
+    plr_adaptResize(plrShm->adaptResizeTo[argsIdx]);
+  }
+  if (!plrShm->checkedActionFault[argsIdx]) {
+    return 0;
+  } else if (plrShm->nProc == 2) {
+    // No majority to repair from, the fault can only be reported
+    plrlog(LOG_ERROR, "[%d] Error: Process pair disagrees! Fault detected\n", getpid());
+    plr_abortGroup();
+  }
+  
+  // Arguments disagreed. Every process votes on its own to find & repair the
+  // faulted processes, then the action is run in a separate barrier.
+  // A process voting late may find all arguments agreeing, if the repair
+  // already replaced the faulted processes' published arguments.
+  int goodProc = plr_voteSyscallArgs(argsIdx);
+  if (goodProc >= 0 && goodProc < plrShm->nProc) {
+    if (plr_repairFaultedProcs(goodProc, argsIdx) < 0) {
+      plrlog(LOG_ERROR, "Error: plr_repairFaultedProcs failed\n");
+      exit(1);
+    }
+  } else if (goodProc != -1) {
+    plrlog(LOG_ERROR, "[%d] Error: No processes agree with each other! Unrecoverable fault\n", getpid());
+    plr_abortGroup();
+  }
+  g_ckptRecord = (plrShm->ckptIntervalMs != 0);
+  plr_runAction(actionPtr, actionType);
+  g_ckptRecord = 0;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_checkedAction_act() {
+  int argsIdx = g_checkedArgsIdx;
+  plrShm->adaptResizeTo[argsIdx] = 0;
+  // A quorum release already checked the arguments of the processes present
+  int quorumClosed = __atomic_load_n(&plrShm->quorumArriveMask[argsIdx], __ATOMIC_ACQUIRE) & PLR_QUORUM_CLOSED;
+  if (!quorumClosed && plr_voteSyscallArgs(argsIdx) != -1) {
+    // Leave the repair to all processes after the barrier
+    plrShm->checkedActionFault[argsIdx] = 1;
+    return 0;
+  }
+  plrShm->checkedActionFault[argsIdx] = 0;
+  if (plrShm->adaptCleanMs) {
+    plrShm->adaptResizeTo[argsIdx] = plr_adaptDecide();
+  }
+  
+  // A NULL action is only checking the arguments
+  int ret = 0;
+  g_logDataLen = 0;
+  g_logRecording = (plrShm->ckptIntervalMs != 0);
+  if (g_checkedActionPtr != NULL) {
+    ret = g_checkedActionPtr();
+    g_executedAction = (ret == 0);
+  }
+  g_logRecording = 0;
+  if (plrShm->ckptIntervalMs && ret == 0) {
+    plr_ckptLogCall(argsIdx);
+  }
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_beginCheckedCall() {
+  if (g_adaptGrowTo) {
+    plr_adaptGrow();
+  }
+  if (plrShm->scrubInterval && !g_scrubbing && ++g_scrubCalls % plrShm->scrubInterval == 0) {
+    g_scrubbing = 1;
+    plr_scrubMemory();
+    g_scrubbing = 0;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_checkQuorumVerdict(const syscallArgs_t *args, int argsIdx) {
+  // The quorum's arguments stay published until this process reaches its
+  // next barrier, since the others can't get past that one without it
+  int lateIdx = g_quorumLateIdx;
+  unsigned int mask = __atomic_load_n(&plrShm->quorumArriveMask[lateIdx], __ATOMIC_ACQUIRE);
+  int quorumIdx = __builtin_ctz(mask & ~PLR_QUORUM_CLOSED);
+  perProcData_t *quorumProc = &allProcShm[quorumIdx];
+  int faultVal = plrC_compareArgs(args, &quorumProc->syscallArgs[lateIdx]);
+  if (myProcShm->deferredHash[argsIdx] != quorumProc->deferredHash[lateIdx]) {
+    faultVal |= 1 << 7;
+  }
+  if (faultVal == 0) {
+    // Results of the action are read from shared memory like any process
+    // that didn't run it
+    return 0;
+  }
+  
+  // Disagreed with the quorum. Same as a process voted faulted, except that
+  // the others are already waiting at the next barrier, so wake them up to
+  // replace this process.
+  plrlog(LOG_DEBUG, "[%d] Late process disagrees with quorum (0x%X)\n", getpid(), faultVal);
+  __atomic_store_n(&myProcShm->awaitingRepair, 1, __ATOMIC_RELEASE);
+  for (int i = 0; i < plrShm->nProc; ++i) {
+    if (myProcShm != &allProcShm[i]) {
+      plr_futexWakeProc(&allProcShm[i]);
+    }
+  }
+  while (1) {
+    pause();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_asyncCheckedAction(const syscallArgs_t *args, int (*actionPtr)(void)) {
+  // Done with the results of the last entry
+  if (g_asyncHolding) {
+    g_asyncHolding = 0;
+    g_asyncEntry = NULL;
+    __atomic_store_n(&myProcShm->asyncSeq, myProcShm->asyncSeq+1, __ATOMIC_SEQ_CST);
+    plr_asyncWakeWaiters();
+  }
+  
+  int ret;
+  do {
+    if (plr_isMasterProcess()) {
+      ret = plr_asyncMasterAction(args, actionPtr);
+    } else {
+      ret = plr_asyncSlaveAction(args);
+    }
+  } while (ret == 1);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_asyncMasterAction(const syscallArgs_t *args, int (*actionPtr)(void)) {
+  unsigned long seq = __atomic_load_n(&plrShm->asyncHead, __ATOMIC_ACQUIRE);
+  int ret = plr_asyncWaitSpace(seq);
+  if (ret != 0) {
+    return ret;
+  }
+  
+  asyncEntry_t *entry = &plrShm->asyncRing[seq % plrShm->asyncLag];
+  memcpy(&entry->args, args, sizeof(syscallArgs_t));
+  entry->deferredHash = g_deferredHash;
+  g_deferredHash = 0;
+  g_epochCalls = 0;
+  entry->dataOffset = plrShm->asyncDataEnd;
+  entry->dataLen = 0;
+  entry->drain = 0;
+  
+  g_executedAction = 0;
+  if (actionPtr) {
+    g_asyncEntry = entry;
+    int actRet = actionPtr();
+    g_asyncEntry = NULL;
+    if (actRet < 0) {
+      plrlog(LOG_ERROR, "[%d] Error: Asynchronous mode action failed\n", getpid());
+      exit(1);
+    }
+    g_executedAction = (actRet == 0);
+  }
+  
+  // Results of the next entry start on a new cache line
+  int dataEnd = entry->dataOffset + entry->dataLen;
+  plrShm->asyncDataEnd = (dataEnd + PLR_CACHE_LINE_SIZE-1) & ~(PLR_CACHE_LINE_SIZE-1);
+  __atomic_store_n(&plrShm->asyncHead, seq+1, __ATOMIC_SEQ_CST);
+  plr_asyncWakeWaiters();
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_asyncSlaveAction(const syscallArgs_t *args) {
+  unsigned long seq = myProcShm->asyncSeq;
+  asyncEntry_t *entry;
+  while (1) {
+    int ret = plr_asyncWaitEntry(seq);
+    if (ret != 0) {
+      return ret;
+    }
+    
+    entry = &plrShm->asyncRing[seq % plrShm->asyncLag];
+    int faultVal = plrC_compareArgs(args, &entry->args);
+    if (entry->deferredHash != g_deferredHash) {
+      faultVal |= 1 << 7;
+    }
+    if (faultVal == 0) {
+      break;
+    }
+    
+    plrlog(LOG_DEBUG, "[%d] Arguments disagree with master at entry %lu (0x%X)\n", getpid(), seq, faultVal);
+    ret = plr_asyncResolveDivergence(args, seq);
+    if (ret != 0) {
+      return ret;
+    }
+    // Master was replaced, check against the new master's entry
+  }
+  
+  g_deferredHash = 0;
+  g_epochCalls = 0;
+  __atomic_store_n(&myProcShm->asyncVerified, seq+1, __ATOMIC_SEQ_CST);
+  plr_asyncWakeWaiters();
+  
+  // Results are read from the entry until the next checked syscall
+  g_asyncEntry = entry;
+  g_asyncHolding = 1;
+  g_executedAction = 0;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_asyncWaitSpace(unsigned long seq) {
+  __atomic_store_n(&myProcShm->asyncWaiting, 1, __ATOMIC_SEQ_CST);
+  struct timespec deadline = plr_asyncDeadline();
+  unsigned long lastMinSeq = seq;
+  int timedOut = 0;
+  int ret = 0;
+  while (1) {
+    int futexVal = __atomic_load_n(&myProcShm->futexWord, __ATOMIC_ACQUIRE);
+    
+    // Find the slave furthest behind, and any slave that is faulted
+    int laggard = -1;
+    int faulted = -1;
+    unsigned long minSeq = seq;
+    for (int i = 1; i < plrShm->nProc; ++i) {
+      if (__atomic_load_n(&allProcShm[i].awaitingRepair, __ATOMIC_ACQUIRE)) {
+        faulted = i;
+      }
+      unsigned long procSeq = __atomic_load_n(&allProcShm[i].asyncSeq, __ATOMIC_ACQUIRE);
+      if (procSeq < minSeq) {
+        minSeq = procSeq;
+        laggard = i;
+      }
+    }
+    
+    // With too many results stored, or after an action the slaves have to
+    // redo against the same file state, wait until all of them caught up
+    const asyncEntry_t *prev = &plrShm->asyncRing[(seq-1) % plrShm->asyncLag];
+    int haveSpace;
+    if (plrShm->asyncDataEnd > PLR_ASYNC_DATA_LIMIT || (seq > 0 && prev->drain)) {
+      haveSpace = (minSeq == seq);
+    } else {
+      haveSpace = (seq - minSeq < (unsigned long)plrShm->asyncLag);
+    }
+    
+    int replaceIdx = -1;
+    if (faulted >= 0) {
+      plrlog(LOG_DEBUG, "[%d] Replacing faulted pid %d\n", getpid(), allProcShm[faulted].pid);
+      replaceIdx = faulted;
+    } else if (haveSpace) {
+      if (minSeq == seq) {
+        // No slave needs any stored results anymore
+        plrShm->asyncDataEnd = 0;
+      }
+      break;
+    } else if (minSeq != lastMinSeq || __atomic_load_n(&allProcShm[laggard].asyncWaiting, __ATOMIC_ACQUIRE)) {
+      // Still catching up or busy sorting out a disagreement, not stuck
+      lastMinSeq = minSeq;
+      deadline = plr_asyncDeadline();
+      timedOut = 0;
+    } else if (__atomic_load_n(&allProcShm[laggard].died, __ATOMIC_ACQUIRE) || timedOut) {
+      plrlog(LOG_DEBUG, "[%d] Pid %d fell behind for too long, replacing it\n", getpid(), allProcShm[laggard].pid);
+      replaceIdx = laggard;
+    }
+    
+    if (replaceIdx >= 0) {
+      ret = plr_asyncReplace(replaceIdx, seq, allProcShm[replaceIdx].pid);
+      if (ret != 0) {
+        break;
+      }
+      deadline = plr_asyncDeadline();
+      timedOut = 0;
+      continue;
+    }
+    timedOut = plr_asyncPark(futexVal, &deadline);
+  }
+  
+  __atomic_store_n(&myProcShm->asyncWaiting, 0, __ATOMIC_RELAXED);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_asyncWaitEntry(unsigned long seq) {
+  __atomic_store_n(&myProcShm->asyncWaiting, 1, __ATOMIC_SEQ_CST);
+  struct timespec deadline = plr_asyncDeadline();
+  int masterPid = __atomic_load_n(&allProcShm[0].pid, __ATOMIC_ACQUIRE);
+  int timedOut = 0;
+  int ret = 0;
+  while (1) {
+    int futexVal = __atomic_load_n(&myProcShm->futexWord, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&plrShm->asyncHead, __ATOMIC_ACQUIRE) > seq) {
+      break;
+    }
+    
+    int curPid = __atomic_load_n(&allProcShm[0].pid, __ATOMIC_ACQUIRE);
+    if (curPid <= 0) {
+      // A replacement master is taking the slot, wait for it
+      deadline = plr_asyncDeadline();
+      timedOut = 0;
+      plr_asyncPark(futexVal, &deadline);
+      continue;
+    } else if (curPid != masterPid || __atomic_load_n(&allProcShm[0].asyncWaiting, __ATOMIC_ACQUIRE)) {
+      // Master was replaced, or is waiting for another slave to catch up.
+      // Either way it isn't stuck.
+      masterPid = curPid;
+      deadline = plr_asyncDeadline();
+      timedOut = 0;
+    } else if (__atomic_load_n(&allProcShm[0].died, __ATOMIC_ACQUIRE) || timedOut) {
+      plrlog(LOG_DEBUG, "[%d] Master pid %d stopped publishing, replacing it\n", getpid(), masterPid);
+      ret = plr_asyncReplace(0, seq, masterPid);
+      if (ret != 0) {
+        break;
+      }
+      masterPid = __atomic_load_n(&allProcShm[0].pid, __ATOMIC_ACQUIRE);
+      deadline = plr_asyncDeadline();
+      timedOut = 0;
+      continue;
+    }
+    timedOut = plr_asyncPark(futexVal, &deadline);
+  }
+  
+  __atomic_store_n(&myProcShm->asyncWaiting, 0, __ATOMIC_RELAXED);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_asyncResolveDivergence(const syscallArgs_t *args, unsigned long seq) {
+  // Publish this process's arguments for the other slave to compare. With 3
+  // processes the slaves are at index 1 & 2.
+  int myIdx = myProcShm - allProcShm;
+  perProcData_t *other = &allProcShm[3 - myIdx];
+  memcpy(&myProcShm->syscallArgs[0], args, sizeof(syscallArgs_t));
+  myProcShm->deferredHash[0] = g_deferredHash;
+  __atomic_store_n(&myProcShm->asyncDiverged, seq+1, __ATOMIC_SEQ_CST);
+  plr_asyncWakeWaiters();
+  
+  __atomic_store_n(&myProcShm->asyncWaiting, 1, __ATOMIC_SEQ_CST);
+  struct timespec deadline = plr_asyncDeadline();
+  int masterPid = __atomic_load_n(&allProcShm[0].pid, __ATOMIC_ACQUIRE);
+  unsigned long lastVerified = 0;
+  int timedOut = 0;
+  int ret = 0;
+  while (1) {
+    int futexVal = __atomic_load_n(&myProcShm->futexWord, __ATOMIC_ACQUIRE);
+    int curPid = __atomic_load_n(&allProcShm[0].pid, __ATOMIC_ACQUIRE);
+    if (curPid <= 0) {
+      // A replacement master is taking the slot, wait for it. That isn't the
+      // other slave's delay, so its deadline starts over.
+      deadline = plr_asyncDeadline();
+      timedOut = 0;
+      plr_asyncPark(futexVal, &deadline);
+      continue;
+    } else if (curPid != masterPid) {
+      // Master was replaced, check against the new one
+      break;
+    }
+    
+    unsigned long otherVerified = __atomic_load_n(&other->asyncVerified, __ATOMIC_ACQUIRE);
+    if (otherVerified > seq) {
+      // Other slave agreed with the master, so this process is faulted.
+      // Wait for the master to replace it. If the master is already done
+      // with the program, just leave.
+      plrlog(LOG_DEBUG, "[%d] Other slave agrees with master, waiting for repair\n", getpid());
+      __atomic_store_n(&myProcShm->awaitingRepair, 1, __ATOMIC_SEQ_CST);
+      plr_futexWakeProc(&allProcShm[0]);
+      while (!__atomic_load_n(&allProcShm[0].died, __ATOMIC_ACQUIRE)) {
+        futexVal = __atomic_load_n(&myProcShm->futexWord, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&allProcShm[0].died, __ATOMIC_ACQUIRE)) {
+          break;
+        }
+        futex_wait(&myProcShm->futexWord, futexVal, NULL);
+      }
+      _exit(1);
+    }
+    
+    if (__atomic_load_n(&other->asyncDiverged, __ATOMIC_ACQUIRE) == seq+1) {
+      int faultVal = plrC_compareArgs(args, &other->syscallArgs[0]);
+      if (myProcShm->deferredHash[0] != other->deferredHash[0]) {
+        faultVal |= 1 << 7;
+      }
+      if (faultVal != 0) {
+        plrlog(LOG_ERROR, "[%d] Error: No processes agree with each other at entry %lu! Unrecoverable fault\n", getpid(), seq);
+        plr_abortGroup();
+      }
+      
+      // Both slaves agree, so the master is faulted. The lower indexed slave
+      // replaces it with a copy of itself, which runs the action for this
+      // entry again. Anything the master did past it can't be undone.
+      if (myIdx < 3 - myIdx) {
+        plrlog(LOG_DEBUG, "[%d] Slaves agree against master pid %d, replacing it\n", getpid(), masterPid);
+        ret = plr_asyncReplace(0, seq, masterPid);
+        if (ret != 0) {
+          break;
+        }
+        continue;
+      }
+    }
+    
+    if (otherVerified != lastVerified) {
+      // Other slave is still catching up
+      lastVerified = otherVerified;
+      deadline = plr_asyncDeadline();
+      timedOut = 0;
+    } else if (timedOut || __atomic_load_n(&other->died, __ATOMIC_ACQUIRE)) {
+      plrlog(LOG_ERROR, "[%d] Error: Other slave never reached entry %lu! Unrecoverable fault\n", getpid(), seq);
+      plr_abortGroup();
+    }
+    timedOut = plr_asyncPark(futexVal, &deadline);
+  }
+  
+  __atomic_store_n(&myProcShm->asyncDiverged, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&myProcShm->asyncWaiting, 0, __ATOMIC_RELAXED);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_asyncWakeWaiters() {
+  for (int i = 0; i < plrShm->nProc; ++i) {
+    if (myProcShm != &allProcShm[i] && __atomic_load_n(&allProcShm[i].asyncWaiting, __ATOMIC_SEQ_CST)) {
+      plr_futexWakeProc(&allProcShm[i]);
+    }
+  }
+}
+
+static int plr_asyncPark(int futexVal, const struct timespec *deadline) {
+  __atomic_store_n(&myProcShm->futexParked, 1, __ATOMIC_SEQ_CST);
+  int waitRet = futex_wait_abs(&myProcShm->futexWord, futexVal, deadline);
+  int waitErr = errno;
+  __atomic_store_n(&myProcShm->futexParked, 0, __ATOMIC_RELAXED);
+  return (waitRet != 0 && waitErr == ETIMEDOUT);
+}
+
+static struct timespec plr_asyncDeadline() {
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  return tspecAddMs(deadline, plr_watchdogTimeoutMs());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_asyncReplace(int idx, unsigned long seq, int expectPid) {
+  pthread_mutex_lock(&plrShm->lock);
+  if (expectPid <= 0 || allProcShm[idx].pid != expectPid) {
+    // Already replaced by another process
+    pthread_mutex_unlock(&plrShm->lock);
+    return 0;
+  }
+  
+  if (plr_replaceProcessIdx(idx) < 0) {
+    plrlog(LOG_ERROR, "Error: plr_replaceProcessIdx failed\n");
+    exit(1);
+  }
+  
+  // Both this process and the replacement hold the lock here
+  int isReplacement = (myProcShm == &allProcShm[idx]);
+  if (isReplacement) {
+    if (idx == 0) {
+      // Entries the old master published from here on are dropped
+      __atomic_store_n(&plrShm->asyncHead, seq, __ATOMIC_SEQ_CST);
+    } else {
+      myProcShm->asyncSeq = seq;
+      myProcShm->asyncVerified = seq;
+    }
+    g_asyncEntry = NULL;
+    g_asyncHolding = 0;
+    plrlog(LOG_DEBUG, "[%d] Asynchronous mode replacement process started\n", getpid());
+  }
+  pthread_mutex_unlock(&plrShm->lock);
+  if (isReplacement) {
+    // Wake the processes waiting for the slot to be filled
+    plr_asyncWakeWaiters();
+  }
+  return isReplacement;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_logCheckedAction(const syscallArgs_t *args, int (*actionPtr)(void)) {
+  if (plrShm->logMode == PLR_LOG_RECORD) {
+    g_logDataLen = 0;
+    g_executedAction = 0;
+    if (actionPtr) {
+      g_logRecording = 1;
+      int actRet = actionPtr();
+      g_logRecording = 0;
+      if (actRet < 0) {
+        plrlog(LOG_ERROR, "[%d] Error: Recorded action failed\n", getpid());
+        exit(1);
+      }
+      g_executedAction = (actRet == 0);
+    }
+    
+    plrRecord_t rec = { .deferredHash = g_deferredHash, .dataLen = g_logDataLen };
+    memcpy(&rec.args, args, sizeof(syscallArgs_t));
+    if (plrRec_append(plrShm->logPath, &plrShm->logEnd, &rec, extraShm) < 0) {
+      plrlog(LOG_ERROR, "[%d] Error: Appending to the call log failed\n", getpid());
+      exit(1);
+    }
+    plrShm->logRecords++;
+  } else {
+    const plrRecord_t *rec = plrRec_read(plrShm->logPath, g_logOffset);
+    if (rec == NULL) {
+      plr_verifyDiverged("is past the end of the log", 0);
+    }
+    int faultVal = plrC_compareArgs(args, &rec->args);
+    if (rec->deferredHash != g_deferredHash) {
+      faultVal |= 1 << 7;
+    }
+    if (faultVal != 0) {
+      plr_verifyDiverged("disagrees with the log", faultVal);
+    }
+    
+    // Results are read from the record until the next checked syscall
+    g_logRecord = rec;
+    g_logOffset = plrRec_nextOffset(g_logOffset, rec);
+    myProcShm->verifyRecords++;
+    g_executedAction = 0;
+  }
+  
+  g_deferredHash = 0;
+  g_epochCalls = 0;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_verifyDiverged(const char *reason, int faultVal) {
+  unsigned long idx = myProcShm->verifyRecords;
+  plrlog(LOG_ERROR, "[%d] Error: Call %lu %s (0x%X)\n", getpid(), idx, reason, faultVal);
+  myProcShm->verifyDiverged = idx+1;
+  exit(1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_abortGroup() {
+  if (plrShm->ckptIntervalMs) {
+    plr_ckptRollback();
+  }
+  
+  // Kill the rest of the group before any of them can run an action or
+  // replace this process. The lock keeps from killing a process that holds
+  // it, e.g. one still completing the barrier the fault was found at.
+  pthread_mutex_lock(&plrShm->lock);
+  __atomic_store_n(&plrShm->faultDetected, 1, __ATOMIC_SEQ_CST);
+  for (int i = 0; i < plrShm->nProc; ++i) {
+    int pid = __atomic_load_n(&allProcShm[i].pid, __ATOMIC_ACQUIRE);
+    if (myProcShm != &allProcShm[i] && pid > 0) {
+      kill(pid, SIGKILL);
+    }
+  }
+  pthread_mutex_unlock(&plrShm->lock);
+  
+  // _exit since flushing the program's output would need the others
+  _exit(1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_ckptTake() {
+  // Write out the output the master buffered for earlier calls, or the
+  // checkpoint would write it again after a rollback. Done in a barrier,
+  // since the slaves may still be seeking shared fds after the last call.
+  plr_runAction(&plr_ckptFlushAct, WAIT_ACTION_MASTER);
+  if (!plr_isMasterProcess()) {
+    return;
+  }
+  
+  pthread_mutex_lock(&plrShm->lock);
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  plrShm->ckptLastNs = tspecToNs(now);
+  
+  // Make room by dropping the oldest checkpoints, along with the calls only
+  // they would have replayed. The new one doesn't count until its call was
+  // verified, so there's always one left to roll back to.
+  if (plrShm->ckptHead - plrShm->ckptTail > (unsigned long)plrShm->ckptRetain) {
+    while (plrShm->ckptHead - plrShm->ckptTail > (unsigned long)plrShm->ckptRetain) {
+      plr_killAndWait(plrShm->ckpts[plrShm->ckptTail++ % PLR_CKPT_RING_SIZE].pid);
+    }
+    unsigned long keepFrom = plrShm->ckpts[plrShm->ckptTail % PLR_CKPT_RING_SIZE].logOffset;
+    if (plrRec_discard(plrShm->logPath, keepFrom) < 0) {
+      plrlog(LOG_DEBUG, "[%d] Failed to discard checkpoint log before %lu\n", getpid(), keepFrom);
+    }
+  }
+  
+  ckptEntry_t *entry = &plrShm->ckpts[plrShm->ckptHead % PLR_CKPT_RING_SIZE];
+  entry->wake = 0;
+  entry->logOffset = plrShm->logEnd;
+  perProcData_t slotCopy;
+  memcpy(&slotCopy, myProcShm, sizeof(perProcData_t));
+  
+  int pid = fork();
+  if (pid < 0) {
+    // Keep running on the older checkpoints
+    perror("fork");
+  } else if (pid == 0) {
+    plr_ckptResume(entry, &slotCopy);
+    return;
+  } else {
+    plrlog(LOG_DEBUG, "[%d] Took checkpoint %d at call log offset %lu\n", getpid(), pid, entry->logOffset);
+    entry->pid = pid;
+    plrShm->ckptHead++;
+  }
+  pthread_mutex_unlock(&plrShm->lock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_ckptFlushAct() {
+  fflush(NULL);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_ckptResume(ckptEntry_t *entry, perProcData_t *slotCopy) {
+  // Parked until the group is rolled back to this checkpoint. The master
+  // holds plrShm->lock until it's done taking the checkpoint.
+  while (__atomic_load_n(&entry->wake, __ATOMIC_ACQUIRE) == 0) {
+    futex_wait(&entry->wake, 0, NULL);
+  }
+  
+  // Take over slot 0 from the killed group, as it was when the checkpoint
+  // was taken. extraShm is still mapped the same.
+  pthread_mutex_lock(&plrShm->lock);
+  myProcShm = &allProcShm[0];
+  plrSD_initProcDataAsCopy(myProcShm, slotCopy);
+  myProcShm->extraShmMapped = slotCopy->extraShmMapped;
+  plr_notifyFigurehead();
+  g_logOffset = entry->logOffset;
+  g_replayEnd = (g_logOffset < plrShm->ckptReplayEnd) ? plrShm->ckptReplayEnd : 0;
+  plrlog(LOG_DEBUG, "[%d] Resumed checkpoint, replaying call log from %lu to %lu\n", getpid(), g_logOffset, plrShm->ckptReplayEnd);
+  
+  // The rest of the group are copies of it, replaying the same calls
+  for (int i = 1; i < plrShm->nProc; ++i) {
+    if (plr_forkNewProcess(&allProcShm[i]) < 0) {
+      plrlog(LOG_ERROR, "[%d] plr_forkNewProcess failed\n", getpid());
+      exit(1);
+    }
+    if (myProcShm == &allProcShm[i]) {
+      // This is the child that was just created, break out of loop
+      break;
+    }
+  }
+  if (plr_isMasterProcess()) {
+    plrShm->ckptRollback = 0;
+  }
+  // Both the master & every new process hold the lock at this point
+  pthread_mutex_unlock(&plrShm->lock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_ckptRollback() {
+  // A fault found by the barrier action is found by every process, & only
+  // the master rolls back, since it first has to write out the output it
+  // buffered for logged calls. The others wait here to be killed. Nothing
+  // runs live until every process is done replaying, so a process that
+  // diverges while replaying rolls back itself.
+  if (!g_replayEnd && !g_logRecord && !plr_isMasterProcess()) {
+    __atomic_store_n(&myProcShm->awaitingRepair, 1, __ATOMIC_RELEASE);
+    while (1) {
+      pause();
+    }
+  }
+  fflush(NULL);
+  
+  pthread_mutex_lock(&plrShm->lock);
+  // A checkpoint taken at the call that disagreed may already carry the
+  // fault, its state is only verified along with that call
+  while (plrShm->ckptTail < plrShm->ckptHead
+         && plrShm->ckpts[(plrShm->ckptHead-1) % PLR_CKPT_RING_SIZE].logOffset >= plrShm->logEnd) {
+    plr_killAndWait(plrShm->ckpts[--plrShm->ckptHead % PLR_CKPT_RING_SIZE].pid);
+  }
+  if (plrShm->ckptTail == plrShm->ckptHead) {
+    pthread_mutex_unlock(&plrShm->lock);
+    plrlog(LOG_ERROR, "[%d] Error: No checkpoint left to roll back to\n", getpid());
+    return;
+  }
+  
+  // The lock keeps from killing a process that holds it, see
+  // plr_abortGroup. The figurehead leaves the checkpoints alone while the
+  // group is gone.
+  plrShm->ckptRollback = 1;
+  plrShm->ckptAtCall = 0;
+  for (int i = 0; i < plrShm->maxProc; ++i) {
+    int pid = allProcShm[i].pid;
+    if (myProcShm != &allProcShm[i] && pid > 0) {
+      plr_killAndWait(pid);
+    }
+    if (myProcShm != &allProcShm[i] && plrSD_freeProcData(&allProcShm[i]) < 0) {
+      plrlog(LOG_ERROR, "[%d] plrSD_freeProcData failed\n", getpid());
+    }
+  }
+  
+  // Start over with fresh barriers. Killed processes may have claimed or
+  // arrived at the current one.
+  unsigned int gen = plrShm->barrierGen;
+  if ((int)(plrShm->barrierClaimGen - gen) > 0) {
+    gen = plrShm->barrierClaimGen;
+  }
+  gen++;
+  plrShm->barrierGen = gen;
+  plrShm->barrierClaimGen = gen;
+  plrShm->curWaitIdx = gen & 1;
+  plrShm->barrierActionIdx = -1;
+  plrShm->restoring = 0;
+  for (int i = 0; i < 2; ++i) {
+    plrShm->condWaitCnt[i] = 0;
+    plrShm->quorumArriveMask[i] = 0;
+    plrShm->watchdogArmed[i] = 0;
+    plrShm->checkedActionFault[i] = 0;
+    plrShm->adaptResizeTo[i] = 0;
+  }
+  
+  // Resume the newest checkpoint, which replays every call logged since
+  ckptEntry_t *entry = &plrShm->ckpts[--plrShm->ckptHead % PLR_CKPT_RING_SIZE];
+  plrShm->ckptReplayEnd = plrShm->logEnd;
+  plrlog(LOG_DEBUG, "[%d] Rolling back to checkpoint %d\n", getpid(), entry->pid);
+  __atomic_store_n(&entry->wake, 1, __ATOMIC_RELEASE);
+  futex_wake(&entry->wake, 1);
+  plrSD_freeProcData(myProcShm);
+  pthread_mutex_unlock(&plrShm->lock);
+  _exit(1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_ckptLogCall(int argsIdx) {
+  plrRecord_t rec = { .deferredHash = myProcShm->deferredHash[argsIdx], .dataLen = g_logDataLen };
+  memcpy(&rec.args, &myProcShm->syscallArgs[argsIdx], sizeof(syscallArgs_t));
+  if (plrRec_append(plrShm->logPath, &plrShm->logEnd, &rec, extraShm) < 0) {
+    plrlog(LOG_ERROR, "[%d] Error: Appending to the checkpoint log failed\n", getpid());
+    exit(1);
+  }
+  plrShm->logRecords++;
+  
+  // Every process reaches the next call after this one
+  if (plrShm->ckptAtCall <= g_ckptCalls) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (tspecToNs(now) - plrShm->ckptLastNs >= plrShm->ckptIntervalMs * 1000000ULL) {
+      plrShm->ckptAtCall = g_ckptCalls + 1;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_replayCheckedAction(const syscallArgs_t *args) {
+  // Same check as a verifier, except that a process that diverges rolls the
+  // group back further
+  const plrRecord_t *rec = plrRec_read(plrShm->logPath, g_logOffset);
+  if (rec == NULL) {
+    plrlog(LOG_ERROR, "[%d] Error: Replayed call is past the end of the log\n", getpid());
+    plr_abortGroup();
+  }
+  int faultVal = plrC_compareArgs(args, &rec->args);
+  if (rec->deferredHash != g_deferredHash) {
+    faultVal |= 1 << 7;
+  }
+  if (faultVal != 0) {
+    plrlog(LOG_ERROR, "[%d] Error: Replayed call disagrees with the log (0x%X)\n", getpid(), faultVal);
+    plr_abortGroup();
+  }
+  
+  // Results are read from the record until the next checked syscall, which
+  // runs live once all logged calls were replayed
+  g_logRecord = rec;
+  g_logOffset = plrRec_nextOffset(g_logOffset, rec);
+  if (g_logOffset >= g_replayEnd) {
+    plrlog(LOG_DEBUG, "[%d] Done replaying\n", getpid());
+    g_replayEnd = 0;
+  }
+  g_executedAction = 0;
+  g_deferredHash = 0;
+  g_epochCalls = 0;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_killAndWait(int pid) {
+  // A pidfd is readable once the process is gone. A killed checkpoint may
+  // still be a child of this process.
+#ifdef SYS_pidfd_open
+  int pidFd = syscall(SYS_pidfd_open, pid, 0);
+#else
+  int pidFd = -1;
+#endif
+  kill(pid, SIGKILL);
+  if (pidFd >= 0) {
+    struct pollfd pfd = { .fd = pidFd, .events = POLLIN };
+    while (poll(&pfd, 1, -1) < 0 && errno == EINTR);
+    close(pidFd);
+  }
+  waitpid(pid, NULL, WNOHANG);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_scrubMemory() {
+  if (g_scrubNRanges < 0 && plr_scrubInit() < 0) {
+    plrlog(LOG_ERROR, "[%d] Error: Memory scrubbing setup failed, not scrubbing\n", getpid());
+    g_scrubNRanges = 0;
+  }
+  
+  // Without soft-dirty bits, or in a process forked since the last scrub,
+  // every chunk counts as written
+  char dirty[g_scrubNChunks ? g_scrubNChunks : 1];
+  int all = (!g_scrubSoftDirty || g_scrubPid != getpid() || plr_scrubFindDirty(dirty) < 0);
+  if (g_scrubSoftDirty && plr_scrubClearSoftDirty() < 0) {
+    plrlog(LOG_DEBUG, "[%d] Clearing soft-dirty bits failed, hashing all chunks\n", getpid());
+    g_scrubSoftDirty = 0;
+  }
+  g_scrubPid = getpid();
+  
+  long pageSize = sysconf(_SC_PAGESIZE);
+  unsigned long chunk = 0;
+  unsigned long nHashed = 0;
+  for (int r = 0; r < g_scrubNRanges; ++r) {
+    for (unsigned long addr = g_scrubRanges[r].start; addr < g_scrubRanges[r].end; addr += PLR_SCRUB_CHUNK_PAGES*pageSize, ++chunk) {
+      if (all || dirty[chunk]) {
+        unsigned long len = g_scrubRanges[r].end - addr;
+        if (len > (unsigned long)(PLR_SCRUB_CHUNK_PAGES*pageSize)) {
+          len = PLR_SCRUB_CHUNK_PAGES*pageSize;
+        }
+        g_scrubDigests[chunk] = plr_hash(PLR_HASH_STATE, 0, (const void*)addr, len);
+        ++nHashed;
+      }
+    }
+  }
+  plrlog(LOG_DEBUG, "[%d] Scrub hashed %lu of %lu chunks\n", getpid(), nHashed, g_scrubNChunks);
+  
+  syscallArgs_t args = {
+    .addr = PLR_ADDR_SCRUB,
+    .arg[0] = plr_hash(PLR_HASH_STATE, 0, g_scrubDigests, g_scrubNChunks*sizeof(unsigned long)),
+    .arg[1] = g_scrubNChunks,
+  };
+  plr_checkSyscallArgs(&args);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_scrubInit() {
+  // The writable mappings of the program's executable, & the anonymous one
+  // right after them that holds the rest of its bss. All processes were
+  // forked from the one that exec'd it, so they look up the same ranges.
+  char exePath[PATH_MAX];
+  ssize_t exeLen = readlink("/proc/self/exe", exePath, sizeof(exePath)-1);
+  if (exeLen < 0) {
+    perror("readlink");
+    return -1;
+  }
+  exePath[exeLen] = '\0';
+  
+  FILE *maps = fopen("/proc/self/maps", "r");
+  if (maps == NULL) {
+    perror("fopen");
+    return -1;
+  }
+  g_scrubNRanges = 0;
+  unsigned long prevExeEnd = 0;
+  char line[PATH_MAX + 128];
+  while (fgets(line, sizeof(line), maps) != NULL) {
+    unsigned long start, end;
+    char perms[8];
+    int pathOffset = 0;
+    if (sscanf(line, "%lx-%lx %7s %*s %*s %*s %n", &start, &end, perms, &pathOffset) < 3) {
+      continue;
+    }
+    char *path = line + pathOffset;
+    path[strcspn(path, "\n")] = '\0';
+    int isExe = (strcmp(path, exePath) == 0);
+    int isBss = (path[0] == '\0' && start == prevExeEnd);
+    prevExeEnd = isExe ? end : 0;
+    if ((isExe || isBss) && perms[1] == 'w' && perms[3] == 'p' && g_scrubNRanges < PLR_SCRUB_MAX_RANGES) {
+      g_scrubRanges[g_scrubNRanges].start = start;
+      g_scrubRanges[g_scrubNRanges].end = end;
+      g_scrubNRanges++;
+    }
+  }
+  fclose(maps);
+  
+  long pageSize = sysconf(_SC_PAGESIZE);
+  unsigned long nPages = 0;
+  g_scrubNChunks = 0;
+  for (int r = 0; r < g_scrubNRanges; ++r) {
+    unsigned long rangePages = (g_scrubRanges[r].end - g_scrubRanges[r].start) / pageSize;
+    nPages = (rangePages > nPages) ? rangePages : nPages;
+    g_scrubNChunks += (rangePages + PLR_SCRUB_CHUNK_PAGES-1) / PLR_SCRUB_CHUNK_PAGES;
+  }
+  
+  // Kept out of the heap, which differs between the processes anyway
+  size_t digestsSize = (g_scrubNChunks ? g_scrubNChunks : 1) * sizeof(unsigned long);
+  size_t pagemapSize = (nPages ? nPages : 1) * sizeof(uint64_t);
+  char *buf = mmap(NULL, digestsSize + pagemapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buf == MAP_FAILED) {
+    perror("mmap");
+    return -1;
+  }
+  g_scrubDigests = (unsigned long*)buf;
+  g_scrubPagemap = (uint64_t*)(buf + digestsSize);
+  
+  // Soft-dirty bits are only usable if writing a page sets its bit again
+  // after clearing them
+  volatile char *probe = mmap(NULL, pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (probe != MAP_FAILED) {
+    probe[0] = 1;
+    g_scrubSoftDirty = 1;
+    int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    uint64_t entry = 0;
+    if (fd < 0 || plr_scrubClearSoftDirty() < 0) {
+      g_scrubSoftDirty = 0;
+    } else {
+      probe[0] = 2;
+      if (pread(fd, &entry, sizeof(entry), ((unsigned long)probe / pageSize) * sizeof(entry)) != sizeof(entry)
+          || !(entry & (1ULL << 55))) {
+        g_scrubSoftDirty = 0;
+      }
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    munmap((void*)probe, pageSize);
+  }
+  plrlog(LOG_DEBUG, "[%d] Scrubbing %d ranges in %lu chunks, %s soft-dirty bits\n", getpid(),
+    g_scrubNRanges, g_scrubNChunks, g_scrubSoftDirty ? "with" : "without");
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_scrubFindDirty(char *dirty) {
+  int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    perror("open");
+    return -1;
+  }
+  
+  long pageSize = sysconf(_SC_PAGESIZE);
+  unsigned long chunk = 0;
+  int ret = 0;
+  for (int r = 0; r < g_scrubNRanges && ret == 0; ++r) {
+    unsigned long nPages = (g_scrubRanges[r].end - g_scrubRanges[r].start) / pageSize;
+    size_t size = nPages * sizeof(uint64_t);
+    if (pread(fd, g_scrubPagemap, size, (g_scrubRanges[r].start / pageSize) * sizeof(uint64_t)) != (ssize_t)size) {
+      perror("pread");
+      ret = -1;
+      break;
+    }
+    for (unsigned long page = 0; page < nPages; page += PLR_SCRUB_CHUNK_PAGES, ++chunk) {
+      dirty[chunk] = 0;
+      for (unsigned long i = page; i < nPages && i < page + PLR_SCRUB_CHUNK_PAGES; ++i) {
+        dirty[chunk] |= ((g_scrubPagemap[i] >> 55) & 1);
+      }
+    }
+  }
+  close(fd);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_scrubClearSoftDirty() {
+  int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  int ret = (write(fd, "4", 1) == 1) ? 0 : -1;
+  close(fd);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_adaptDecide() {
+  if (plrShm->adaptGrow) {
+    plrShm->adaptGrow = 0;
+    if (plrShm->nProc < plrShm->maxProc) {
+      return plrShm->maxProc;
+    }
+    return 0;
+  }
+  
+  if (plrShm->nProc > PLR_ADAPT_MIN_PROC) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    unsigned long long nowNs = tspecToNs(now);
+    if (nowNs - plrShm->adaptLastEventNs >= plrShm->adaptHoldMs * 1000000ULL) {
+      // Quiet for long enough. The next clean period is shorter again, down
+      // to the configured one.
+      plrShm->adaptLastEventNs = nowNs;
+      if (plrShm->adaptHoldMs/2 >= plrShm->adaptCleanMs) {
+        plrShm->adaptHoldMs /= 2;
+      }
+      return PLR_ADAPT_MIN_PROC;
+    }
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_adaptResize(int nProc) {
+  int myIdx = myProcShm - allProcShm;
+  if (myIdx >= nProc) {
+    // Retired, wait here for the master to kill this process
+    __atomic_store_n(&myProcShm->awaitingRepair, 1, __ATOMIC_RELEASE);
+    while (1) {
+      pause();
+    }
+  }
+  
+  // The master resizes, all other processes continue right away. They can't
+  // get past the next barrier without the master, so the group is resized
+  // before that barrier completes.
+  if (!plr_isMasterProcess()) {
+    return;
+  }
+  
+  int oldNProc = plrShm->nProc;
+  plrlog(LOG_DEBUG, "[%d] Adaptive redundancy, resizing from %d to %d processes\n", getpid(), oldNProc, nProc);
+  if (nProc < oldNProc) {
+    // Retired processes never arrive at the next barrier
+    pthread_mutex_lock(&plrShm->lock);
+    plrShm->nProc = nProc;
+    pthread_mutex_unlock(&plrShm->lock);
+    
+    // A retired process may not have left the last barrier yet, see
+    // plr_repairFaultedProcs
+    for (int i = nProc; i < oldNProc; ++i) {
+      struct timespec now, waitEnd;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      waitEnd = tspecAddMs(now, plrShm->watchdogTimeout);
+      while (!__atomic_load_n(&allProcShm[i].awaitingRepair, __ATOMIC_ACQUIRE)) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > waitEnd.tv_sec || (now.tv_sec == waitEnd.tv_sec && now.tv_nsec >= waitEnd.tv_nsec)) {
+          plrlog(LOG_ERROR, "[%d] Error: Retired pid %d never stopped, killing it anyway\n", getpid(), allProcShm[i].pid);
+          break;
+        }
+        sched_yield();
+      }
+      
+      pthread_mutex_lock(&plrShm->lock);
+      kill(allProcShm[i].pid, SIGKILL);
+      if (plrSD_freeProcData(&allProcShm[i]) < 0) {
+        plrlog(LOG_ERROR, "[%d] plrSD_freeProcData failed\n", getpid());
+      }
+      pthread_mutex_unlock(&plrShm->lock);
+    }
+  } else {
+    // Grown once the master starts its next checked syscall
+    g_adaptGrowTo = nProc;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_adaptGrow() {
+  // New processes are copies of the master, taken before it arrives at the
+  // next barrier & before it runs anything for this syscall. The other
+  // processes can't get past that barrier without it, so they all wait
+  // there for the new ones.
+  int nProc = g_adaptGrowTo;
+  g_adaptGrowTo = 0;
+  
+  pthread_mutex_lock(&plrShm->lock);
+  int oldNProc = plrShm->nProc;
+  plrShm->nProc = nProc;
+  for (int i = oldNProc; i < nProc; ++i) {
+    if (plr_forkNewProcess(&allProcShm[i]) < 0) {
+      plrlog(LOG_ERROR, "[%d] plr_forkNewProcess failed\n", getpid());
+      exit(1);
+    }
+    if (myProcShm == &allProcShm[i]) {
+      // This is the child that was just created, break out of loop
+      break;
+    }
+  }
+  // Both the master & every new process hold the lock at this point
+  pthread_mutex_unlock(&plrShm->lock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_adaptNoteFault() {
+  if (!plrShm->adaptCleanMs) {
+    return;
+  }
+  
+  // Faults coming in at a higher rate keep the group at full size longer
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  plrShm->adaptLastEventNs = tspecToNs(now);
+  if (plrShm->adaptHoldMs*2 <= plrShm->adaptCleanMs*PLR_ADAPT_MAX_BACKOFF) {
+    plrShm->adaptHoldMs *= 2;
+  }
+  plrShm->adaptGrow = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_voteSyscallArgs(int argsIdx) {
+  int nProc = plrShm->nProc;
+  
+  // Key every process by a hash of its arguments, so that most comparisons
+  // don't need to go through all of them
+  unsigned long hashes[nProc];
+  for (int i = 0; i < nProc; ++i) {
+    hashes[i] = plrC_hashArgs(allProcShm[i].deferredHash[argsIdx], &allProcShm[i].syscallArgs[argsIdx]);
+  }
+  
+  // Boyer-Moore majority vote. If any group of identical arguments is a
+  // majority, it's the candidate left at the end.
+  int candidate = 0;
+  int count = 0;
+  for (int i = 0; i < nProc; ++i) {
+    if (count == 0) {
+      candidate = i;
+      count = 1;
+    } else if (plr_sameProcArgs(candidate, i, argsIdx, hashes)) {
+      ++count;
+    } else {
+      --count;
+    }
+  }
+  
+  // Count the candidate's group, & find its lowest index
+  int goodProc = -1;
+  int nAgree = 0;
+  for (int i = 0; i < nProc; ++i) {
+    if (i == candidate || plr_sameProcArgs(candidate, i, argsIdx, hashes)) {
+      if (goodProc < 0) {
+        goodProc = i;
+      }
+      ++nAgree;
+    }
+  }
+  
+  if (nAgree == nProc) {
+    // All arguments agree
+    return -1;
+  } else if (nAgree > nProc/2) {
+    return goodProc;
+  } else {
+    // No majority, which is any disagreement with 2 processes
+    return nProc;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plr_sameProcArgs(int idx1, int idx2, int argsIdx, const unsigned long *hashes) {
+  return hashes[idx1] == hashes[idx2] && plr_compareProcArgs(idx1, idx2, argsIdx) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_compareProcArgs(int idx1, int idx2, int argsIdx) {
+  perProcData_t *proc1 = &allProcShm[idx1], *proc2 = &allProcShm[idx2];
+  int faultVal = plrC_compareArgs(&proc1->syscallArgs[argsIdx], &proc2->syscallArgs[argsIdx]);
+  if (proc1->deferredHash[argsIdx] != proc2->deferredHash[argsIdx]) {
+    faultVal |= 1 << 7;
+    plrlog(LOG_DEBUG, "Deferred check miscompare, hash 0x%lX != 0x%lX\n",
+      proc1->deferredHash[argsIdx], proc2->deferredHash[argsIdx]);
+  }
+  return faultVal;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_repairFaultedProcs(int goodProc, int argsIdx) {
+  if (plr_compareProcArgs(goodProc, myProcShm - allProcShm, argsIdx) != 0) {
+    // Detected current process as faulted. Don't let it run ahead into the
+    // next barrier, just wait here for a good process to replace it.
+    plrlog(LOG_DEBUG, "[%d] Current process is bad!\n", getpid());
+    __atomic_store_n(&myProcShm->awaitingRepair, 1, __ATOMIC_RELEASE);
+    while (1) {
+      pause();
+    }
+  }
+  
+  // The lowest indexed good process repairs, all other good processes
+  // continue right away. They can't get past the next barrier until the
+  // replacement processes arrive at it.
+  if (myProcShm != &allProcShm[goodProc]) {
+    return 0;
+  }
+  
+  int ret = 0;
+  for (int badProc = 0; badProc < plrShm->nProc && ret == 0; ++badProc) {
+    if (badProc == goodProc || plr_compareProcArgs(goodProc, badProc, argsIdx) == 0) {
+      continue;
+    }
+    
+    // The bad process may not have left the last barrier yet. Killing it
+    // there would leave its arrival counted, so wait until it parks itself.
+    struct timespec now, waitEnd;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    waitEnd = tspecAddMs(now, plrShm->watchdogTimeout);
+    while (!__atomic_load_n(&allProcShm[badProc].awaitingRepair, __ATOMIC_ACQUIRE)) {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if (now.tv_sec > waitEnd.tv_sec || (now.tv_sec == waitEnd.tv_sec && now.tv_nsec >= waitEnd.tv_nsec)) {
+        plrlog(LOG_ERROR, "[%d] Error: Faulted pid %d never stopped, replacing it anyway\n", getpid(), allProcShm[badProc].pid);
+        break;
+      }
+      sched_yield();
+    }
+    
+    // Replace bad process with copy of current process
+    pthread_mutex_lock(&plrShm->lock);
+    plrlog(LOG_DEBUG, "[%d] Replacing faulted pid %d\n", getpid(), allProcShm[badProc].pid);
+    plr_adaptNoteFault();
+    ret = plr_replaceProcessIdx(badProc);
+    if (ret < 0) {
+      plrlog(LOG_ERROR, "Error: plr_replaceProcessIdx failed\n");
+    }
+    // Both this process and the replacement hold the lock at this point.
+    // The replacement leaves the loop, it has nothing left to repair.
+    pthread_mutex_unlock(&plrShm->lock);
+    if (myProcShm == &allProcShm[badProc]) {
+      break;
+    }
+  }
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_isMasterProcess() {
+  // Whichever process is index 0 in allProcShm is treated as the 
+  // "master process"
+  if (myProcShm == &allProcShm[0]) {
+    return 1;
+  } else {
+    return 0;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_masterAction(int (*actionPtr)(void)) {
+  return plr_runAction(actionPtr, WAIT_ACTION_MASTER);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_executorAction(int (*actionPtr)(void)) {
+  return plr_runAction(actionPtr, WAIT_ACTION_ANY);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_runAction(int (*actionPtr)(void), waitActionType_t actionType) {
+  // Wait for all processes to reach this barrier, then the process selected
+  // by actionType will run the provided function
+  g_actionPtr = actionPtr;
+  g_executedAction = 0;
+  if (plr_waitBarrier(&plr_runAction_act, actionType) < 0) {
+    plrlog(LOG_ERROR, "Error: plr_waitBarrier failed\n");
+    exit(1);
+  }
+  
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_runAction_act() {
+  // A NULL action is left over from a checked syscall that only checked
+  // its arguments, after a repair
+  int ret = 0;
+  g_logDataLen = 0;
+  g_logRecording = g_ckptRecord;
+  if (g_actionPtr != NULL) {
+    ret = g_actionPtr();
+    g_executedAction = (ret == 0);
+  }
+  g_logRecording = 0;
+  if (g_ckptRecord && ret == 0) {
+    plr_ckptLogCall(g_checkedArgsIdx);
+  }
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_isExecutorProcess() {
+  return g_executedAction;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+long plr_outputBatchLimit() {
+  return plrShm->outputBatchLimit;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_checkBudget() {
+  return plrShm->checkBudgetPct;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned long plr_hash(plrHashClass_t cls, unsigned long seed, const void *buf, size_t len) {
+  return plrH_hash(plrShm->hashAlgo[cls], seed, buf, len);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned long plr_copyHash(plrHashClass_t cls, unsigned long seed, void *dest, const void *src, size_t len) {
+  return plrH_copyHash(plrShm->hashAlgo[cls], seed, dest, src, len);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_isVerifying() {
+  return plrShm->logMode == PLR_LOG_VERIFY;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_isReplaying() {
+  // Results of a replayed call are read from its record until the next call
+  return plrShm->logMode == PLR_LOG_OFF && g_logRecord != NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void plr_waitForSlavesAfterAction() {
+  // Only the master has an entry without holding it
+  if (g_asyncEntry && !g_asyncHolding) {
+    g_asyncEntry->drain = 1;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_copyToShm(const void *src, size_t length, size_t offset) {
+  memcpy(plr_shmDest(length, offset), src, length);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned long plr_copyToShmHashed(const void *src, size_t length, size_t offset) {
+  return plrH_copyHash(plrShm->hashAlgo[PLR_HASH_DATA], 0, plr_shmDest(length, offset), src, length);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_copyFromShm(void *dest, size_t length, size_t offset) {
+  memcpy(dest, plr_shmSource(length, offset), length);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_copyFromShmChecked(void *dest, size_t length, size_t offset, unsigned long digest) {
+  const char *src = plr_shmSource(length, offset);
+  if (plrH_copyHash(plrShm->hashAlgo[PLR_HASH_DATA], 0, dest, src, length) == digest) {
+    return 0;
+  }
+  
+  // The results were corrupted since the executor copied them, or this
+  // process copied them wrong. Either way the data can't be trusted.
+  if (plrShm->logMode == PLR_LOG_VERIFY) {
+    plr_verifyDiverged("reads results that don't match their digest", 0);
+  } else if (g_logRecord) {
+    plrlog(LOG_ERROR, "[%d] Error: Replayed call reads results that don't match their digest\n", getpid());
+    plr_abortGroup();
+  }
+  // Dying here gets this process replaced with a copy of a good one, like
+  // any other fault. _exit since the program's buffered output isn't
+  // trusted either.
+  plrlog(LOG_ERROR, "[%d] Error: Results at extraShm offset %zu don't match their digest\n", getpid(), offset);
+  _exit(1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static char *plr_shmDest(size_t length, size_t offset) {
+  // In asynchronous mode, results go with the master's current ring entry
+  if (g_asyncEntry) {
+    if ((int)(offset+length) > g_asyncEntry->dataLen) {
+      g_asyncEntry->dataLen = offset+length;
+    }
+    offset += g_asyncEntry->dataOffset;
+  } else if (g_logRecording && offset+length > g_logDataLen) {
+    g_logDataLen = offset+length;
+  }
+  
+  // First resize extraShm area so that it's at least as big as needed
+  if (plrSD_resizeExtraShm(offset+length) < 0) {
+    plrlog(LOG_ERROR, "[%d] Error: plrSD_resizeExtraShm failed\n", getpid());
+    exit(1);
+  }
+  
+  // Refresh this process's extraShm mapping
+  if (plrSD_refreshExtraShm() < 0) {
+    plrlog(LOG_ERROR, "[%d] Error: plrSD_refreshExtraShm failed\n", getpid());
+    exit(1);
+  }
+  return extraShm+offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const char *plr_shmSource(size_t length, size_t offset) {
+  if (g_asyncEntry) {
+    offset += g_asyncEntry->dataOffset;
+  }
+  
+  // Refresh this process's extraShm mapping
+  if (plrSD_refreshExtraShm() < 0) {
+    plrlog(LOG_ERROR, "[%d] Error: plrSD_refreshExtraShm failed\n", getpid());
+    exit(1);
+  }
+  
+  // Data is in extraShm at specified offset, or in the results of the log
+  // record when verifying. extraShm is mapped either way, so that the
+  // program sees the same fds as when it was recorded.
+  if (g_logRecord) {
+    if (offset+length > g_logRecord->dataLen && plrShm->logMode == PLR_LOG_VERIFY) {
+      plr_verifyDiverged("reads results the log doesn't have", 0);
+    } else if (offset+length > g_logRecord->dataLen) {
+      plrlog(LOG_ERROR, "[%d] Error: Replayed call reads results the log doesn't have\n", getpid());
+      plr_abortGroup();
+    }
+    return (const char*)(g_logRecord+1) + offset;
+  }
+  return extraShm+offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void plr_setInsidePLR() {
+  assert(myProcShm);
+  assert(!myProcShm->insidePLR);
+  myProcShm->insidePLR = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void plr_clearInsidePLR() {
+  assert(myProcShm);
+  assert(myProcShm->insidePLR);
+  myProcShm->insidePLR = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_checkInsidePLR() {
+  assert(g_insidePLRInternal || myProcShm);
+  return g_insidePLRInternal || myProcShm->insidePLR || g_paused;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void plr_setPaused(int paused) {
+  g_paused = paused;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_isPaused() {
+  return g_paused;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_skipPausedEffect() {
+  // Verifiers & replaying processes skip them too, the recorded or rolled
+  // back run already had the effects
+  return g_paused && (!plr_isMasterProcess() || plrShm->logMode == PLR_LOG_VERIFY || g_replayEnd);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_waitBarrier(int (*actionPtr)(void), waitActionType_t actionType) {
+  if (plrShm->barrierMode == PLR_BARRIER_FUTEX) {
+    return plr_waitBarrierFutex(actionPtr, actionType);
+  } else if (plrShm->barrierMode == PLR_BARRIER_TREE) {
+    return plr_waitBarrierTree(actionPtr, actionType);
+  } else {
+    return plr_waitBarrierCond(actionPtr, actionType);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_waitBarrierCond(int (*actionPtr)(void), waitActionType_t actionType) {
+  pthread_mutex_lock(&plrShm->lock);
+  
+  // Ignore calls to plr_wait that come from the wrong pid, seems to
+  // occur when also instrumenting binary with Pin
+  if (myProcShm->pid != getpid()) {
+    pthread_mutex_unlock(&plrShm->lock);
+    return 0;
+  }
+  
+  // Mark this process as waiting at barrier. The first process to arrive
+  // arms the watchdog for everyone.
+  int waitIdx = plrShm->curWaitIdx;
+  assert(plrShm->condWaitCnt[waitIdx] <= plrShm->nProc);
+  myProcShm->waitIdx = waitIdx;
+  plrShm->condWaitCnt[waitIdx]++;
+  if (plrShm->condWaitCnt[waitIdx] == 1) {
+    plr_armWatchdog(plrShm->barrierGen);
+  } else if (plrShm->condWaitCnt[waitIdx] == plrShm->nProc) {
+    plr_recordArrivalSkew(plrShm->barrierGen);
+  }
+  
+  // Wait until all processes have reached this barrier
+  int watchdogExpired = 0;
+  int woken = 0;
+  while (1) {
+    // Check barrier exit conditions
+    if (myProcShm->waitIdx < 0) {
+      // Wait flag already cleared, break out of wait loop
+      break;
+    }
+    if (myProcShm->waitIdx >= 0 && plrShm->condWaitCnt[waitIdx] == plrShm->nProc) {
+      // Exit condition is met but wait flag has not been removed
+      // Call barrier action through provided function ptr now that all
+      // processes are synchronized & waiting at the barrier
+      int actionSuccess = 0;
+      if (actionPtr) {
+        int runAction = 0;
+        
+        switch (actionType) {
+        case WAIT_ACTION_ANY:
+          runAction = 1;
+          break;
+        case WAIT_ACTION_MASTER:
+          if (plr_isMasterProcess()) {
+            runAction = 1;
+          } else {
+            // Wake up master process so it can run action
+            pthread_cond_signal(&allProcShm[0].cond[waitIdx]);
+          }
+          break;
+        case WAIT_ACTION_SLAVE:
+          if (plr_isMasterProcess()) {
+            // Wake up a slave process so it can run action
+            pthread_cond_signal(&allProcShm[1].cond[waitIdx]);
+          } else {
+            runAction = 1;
+          }
+        }
+        
+        if (runAction) {
+          woken = 0;
+          int ret = actionPtr();
+          if (ret < 0) {
+            myProcShm->waitIdx = -1;
+            plrShm->condWaitCnt[waitIdx]--;
+            pthread_mutex_unlock(&plrShm->lock);
+            exit(1);
+          } else if (ret == 0) {
+            actionSuccess = 1;
+          } else {
+            // Signal another process to wake up & run action
+            for (int i = 0; i < plrShm->nProc; ++i) {
+              if (myProcShm != &allProcShm[i]) {
+                pthread_cond_signal(&allProcShm[i].cond[waitIdx]);
+                break;
+              }
+            }
+          }
+        }
+      } else {
+        // No action function ptr provided, default success once exit condition met
+        actionSuccess = 1;
+      }
+      
+      // If barrier action succeeds, wake up all other processes & leave barrier
+      if (actionSuccess) {
+        if (myProcShm->waitIdx >= 0) {
+          // Shift curWaitIdx to other value so subsequent plr_wait calls use the
+          // other condition variable. The generation is only kept to tell
+          // watchdog deadlines apart.
+          plrShm->curWaitIdx = (plrShm->curWaitIdx) ? 0 : 1;
+          plrShm->barrierGen++;
+          
+          // Reset all wait flags and wake up all other processes
+          //printf("[%d] Signaling all processes to wake up for idx %d\n", getpid(), waitIdx);
+          for (int i = 0; i < plrShm->nProc; ++i) {
+            pthread_cond_signal(&allProcShm[i].cond[waitIdx]);
+            allProcShm[i].waitIdx = -1;
+          }
+        }
+        
+        // Break out of wait loop
+        break;
+      }
+    }
+    
+    // Check if watchdog expired. If all processes have arrived, the barrier is
+    // only waiting on the process running the action, so nothing is stuck &
+    // the watchdog just gets rearmed.
+    // The flag is cleared first, since a replacement process forked below
+    // inherits it and must not handle the same expiry again.
+    if (watchdogExpired && plrShm->condWaitCnt[waitIdx] == plrShm->nProc) {
+      watchdogExpired = 0;
+      plr_armWatchdog(plrShm->barrierGen);
+    } else if (watchdogExpired) {
+      watchdogExpired = 0;
+      int ret = plr_watchdogExpired();
+      if (ret < 0) {
+        myProcShm->waitIdx = -1;
+        plrShm->condWaitCnt[waitIdx]--;
+        pthread_mutex_unlock(&plrShm->lock);
+        exit(1);
+      } else if (ret == 1) {
+        // Forked new process to replace stuck one, give it a full watchdog
+        // interval & check barrier exit condition again
+        plr_armWatchdog(plrShm->barrierGen);
+        continue;
+      }
+    }
+    
+    // A process that died is handled like an expired watchdog right away
+    if (plr_deadProcessMissing(waitIdx)) {
+      watchdogExpired = 1;
+      continue;
+    }
+    
+    // Spin-then-park: poll for progress without the lock before sleeping.
+    // A signal sent while the lock isn't held is lost, including one sent
+    // after the spin gave up but before the lock was taken again. So the
+    // progress check is repeated under the lock, after which nothing can
+    // change or be signaled until pthread_cond_timedwait releases it.
+    if (plrShm->spinBudgetUs > 0) {
+      condSpinCtx_t spinCtx = { .waitIdx = waitIdx, .waitCnt = plrShm->condWaitCnt[waitIdx] };
+      pthread_mutex_unlock(&plrShm->lock);
+      int progressed = plr_spinUntil(&plr_condBarrierProgressed, &spinCtx);
+      pthread_mutex_lock(&plrShm->lock);
+      if (progressed || plr_condBarrierProgressed(&spinCtx)) {
+        continue;
+      }
+    }
+    
+    // Back to sleep without anything having changed for this process
+    if (woken) {
+      __atomic_add_fetch(&plrShm->spuriousWakeups, 1, __ATOMIC_RELAXED);
+      woken = 0;
+    }
+    
+    // Using _timedwait as a watchdog timer, to avoid deadlock in case one of the
+    // redundant processes has died or is stuck. The deadline is the same for
+    // every wait of this barrier (CLOCK_MONOTONIC, see pthread_cond_init_pshared),
+    // so an interrupted or spurious wakeup doesn't extend it.
+    struct timespec absWait = plr_watchdogDeadline(plrShm->barrierGen);
+    int ret = pthread_cond_timedwait(&myProcShm->cond[waitIdx], &plrShm->lock, &absWait);
+    if (ret == ETIMEDOUT) {
+      // Loop again to make sure timer didn't expire while last proc was waiting
+      watchdogExpired = 1; 
+    } else if (ret != 0) {
+      plrlog(LOG_ERROR, "[%d] pthread_cond_timedwait returned %d\n", getpid(), ret);
+    } else {
+      __atomic_add_fetch(&plrShm->barrierWakeups, 1, __ATOMIC_RELAXED);
+      woken = 1;
+    }
+  }
+  
+  // Decrement waiting process counter
+  plrShm->condWaitCnt[waitIdx]--;
+  
+  pthread_mutex_unlock(&plrShm->lock);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_waitBarrierFutex(int (*actionPtr)(void), waitActionType_t actionType) {
+  // Ignore calls to plr_wait that come from the wrong pid, seems to
+  // occur when also instrumenting binary with Pin
+  if (myProcShm->pid != getpid()) {
+    return 0;
+  }
+  
+  // This process was late at the last barrier & is done with its results,
+  // let the others be released by a quorum again
+  if (g_quorumCatchUpIdx >= 0) {
+    __atomic_store_n(&plrShm->quorumArriveMask[g_quorumCatchUpIdx], 0, __ATOMIC_RELEASE);
+    g_quorumCatchUpIdx = -1;
+  }
+  
+  // Mark this process as waiting at barrier. The generation can't advance
+  // until this process arrives, so it's safe to read it before arriving.
+  // That doesn't hold for a barrier released by a quorum, which a process
+  // may arrive at after the fact.
+  unsigned int gen = __atomic_load_n(&plrShm->barrierGen, __ATOMIC_ACQUIRE);
+  if (g_quorumBarrier) {
+    unsigned int lateGen;
+    if (plr_quorumArrive(gen, &lateGen)) {
+      plr_quorumWaitLate(lateGen);
+      g_quorumLateIdx = g_quorumCatchUpIdx = lateGen & 1;
+      return 1;
+    }
+  }
+  int waitIdx = gen & 1;
+  myProcShm->waitIdx = waitIdx;
+  int waitCnt = __atomic_add_fetch(&plrShm->condWaitCnt[waitIdx], 1, __ATOMIC_ACQ_REL);
+  assert(waitCnt <= plrShm->nProc);
+  if (waitCnt == 1) {
+    plr_armWatchdog(gen);
+  } else if (waitCnt == plrShm->nProc) {
+    plr_recordArrivalSkew(gen);
+  }
+  
+  // Last process to arrive claims the barrier and starts the action. In
+  // quorum mode, so may the process completing a majority.
+  if ((waitCnt == plrShm->nProc && plr_futexClaimBarrier(gen))
+      || (g_quorumBarrier && plr_quorumTryRelease(gen, actionType))) {
+    if (plr_futexDispatchAction(actionPtr, actionType, gen) < 0) {
+      myProcShm->waitIdx = -1;
+      __atomic_sub_fetch(&plrShm->condWaitCnt[waitIdx], 1, __ATOMIC_ACQ_REL);
+      exit(1);
+    }
+  }
+  
+  // Wait until the barrier generation advances. The futex word must be read
+  // before checking the exit conditions, so that a wakeup issued in between
+  // makes futex_wait return immediately instead of being lost.
+  int woken = 0;
+  while (1) {
+    int futexVal = __atomic_load_n(&myProcShm->futexWord, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&plrShm->barrierGen, __ATOMIC_ACQUIRE) != gen) {
+      // Barrier completed, leave
+      break;
+    }
+    int actionIdx = __atomic_load_n(&plrShm->barrierActionIdx, __ATOMIC_ACQUIRE);
+    if (actionIdx >= 0 && &allProcShm[actionIdx] == myProcShm) {
+      // Barrier action was handed off to this process
+      woken = 0;
+      if (plr_futexRunAction(actionPtr, gen) < 0) {
+        myProcShm->waitIdx = -1;
+        __atomic_sub_fetch(&plrShm->condWaitCnt[waitIdx], 1, __ATOMIC_ACQ_REL);
+        exit(1);
+      }
+      continue;
+    }
+    
+    // A process that died, or that arrived late at the last barrier &
+    // disagreed with the quorum, is waiting to be replaced. No need to wait
+    // for the watchdog.
+    int replaceNow = plr_replaceWithoutWatchdog(gen);
+    if (!replaceNow) {
+      // Spin-then-park: every event this process waits for bumps its futex
+      // word, so poll that before sleeping in the kernel
+      futexSpinCtx_t spinCtx = { .futexVal = futexVal };
+      if (plrShm->spinBudgetUs > 0 && plr_spinUntil(&plr_futexWordChanged, &spinCtx)) {
+        continue;
+      }
+      
+      if (woken) {
+        __atomic_add_fetch(&plrShm->spuriousWakeups, 1, __ATOMIC_RELAXED);
+        woken = 0;
+      }
+      
+      // futexParked tells wakers that a futex_wake is needed. It must be set
+      // before the futex word is compared again inside futex_wait.
+      // All waits share the barrier's watchdog deadline, so wakeups don't
+      // restart the timer.
+      struct timespec deadline = plr_watchdogDeadline(gen);
+      __atomic_store_n(&myProcShm->futexParked, 1, __ATOMIC_SEQ_CST);
+      int waitRet = futex_wait_abs(&myProcShm->futexWord, futexVal, &deadline);
+      int waitErr = errno;
+      __atomic_store_n(&myProcShm->futexParked, 0, __ATOMIC_RELAXED);
+      if (waitRet == 0) {
+        __atomic_add_fetch(&plrShm->barrierWakeups, 1, __ATOMIC_RELAXED);
+        woken = 1;
+        continue;
+      } else if (waitErr != ETIMEDOUT) {
+        // Futex word already changed (or interrupted), recheck exit conditions
+        continue;
+      }
+    }
+    
+    // Watchdog expired, handle it with the lock held like the cond barrier
+    pthread_mutex_lock(&plrShm->lock);
+    if (__atomic_load_n(&plrShm->barrierGen, __ATOMIC_ACQUIRE) != gen
+        || (replaceNow && !plr_replaceWithoutWatchdog(gen))) {
+      // Barrier completed or faulted process replaced while acquiring the lock
+      pthread_mutex_unlock(&plrShm->lock);
+      continue;
+    }
+    if (__atomic_load_n(&plrShm->condWaitCnt[waitIdx], __ATOMIC_ACQUIRE) == plrShm->nProc) {
+      // Everyone arrived, the action is just being handed off. Nothing is
+      // stuck, so rearm the watchdog.
+      plr_armWatchdog(gen);
+      pthread_mutex_unlock(&plrShm->lock);
+      continue;
+    }
+    int ret = plr_watchdogExpired();
+    if (ret == 1) {
+      // Give the replacement process a full watchdog interval
+      plr_armWatchdog(gen);
+    }
+    pthread_mutex_unlock(&plrShm->lock);
+    if (ret < 0) {
+      myProcShm->waitIdx = -1;
+      __atomic_sub_fetch(&plrShm->condWaitCnt[waitIdx], 1, __ATOMIC_ACQ_REL);
+      exit(1);
+    } else if (ret == 1) {
+      // Forked new process to replace stuck one. Both this process and the
+      // replacement get here, whichever claims the barrier completes it.
+      waitCnt = __atomic_load_n(&plrShm->condWaitCnt[waitIdx], __ATOMIC_ACQUIRE);
+      if (waitCnt == plrShm->nProc && plr_futexClaimBarrier(gen)) {
+        if (plr_futexDispatchAction(actionPtr, actionType, gen) < 0) {
+          myProcShm->waitIdx = -1;
+          __atomic_sub_fetch(&plrShm->condWaitCnt[waitIdx], 1, __ATOMIC_ACQ_REL);
+          exit(1);
+        }
+      }
+    }
+  }
+  
+  // A process that arrived while a quorum was already releasing the barrier
+  // may have marked itself waiting after the release
+  myProcShm->waitIdx = -1;
+  
+  // Decrement waiting process counter
+  __atomic_sub_fetch(&plrShm->condWaitCnt[waitIdx], 1, __ATOMIC_ACQ_REL);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Arrive at quorum barrier generation gen. Returns 1 (and sets lateGen) if
+// this process is late for a barrier a quorum already left, 0 otherwise.
+static int plr_quorumArrive(unsigned int gen, unsigned int *lateGen) {
+  unsigned int myBit = 1u << (myProcShm - allProcShm);
+  
+  // Previous barrier was completed by a quorum without this process
+  unsigned int prevMask = __atomic_load_n(&plrShm->quorumArriveMask[(gen+1) & 1], __ATOMIC_ACQUIRE);
+  if ((prevMask & PLR_QUORUM_CLOSED) && !(prevMask & myBit)) {
+    *lateGen = gen-1;
+    return 1;
+  }
+  
+  // Current barrier may get closed by a quorum at any time before arriving
+  unsigned int mask = __atomic_load_n(&plrShm->quorumArriveMask[gen & 1], __ATOMIC_ACQUIRE);
+  do {
+    if (mask & PLR_QUORUM_CLOSED) {
+      *lateGen = gen;
+      return 1;
+    }
+  } while (!__atomic_compare_exchange_n(&plrShm->quorumArriveMask[gen & 1], &mask, mask | myBit,
+                                        0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Returns 1 if the calling process claimed barrier generation gen for a
+// quorum of the processes, closing it to the others.
+static int plr_quorumTryRelease(unsigned int gen, waitActionType_t actionType) {
+  int quorum = plrShm->nProc/2 + 1;
+  int argsIdx = gen & 1;
+  unsigned int allBits = (1u << plrShm->nProc) - 1;
+  
+  // Only one process may be behind at a time. The previous barrier's late
+  // process must catch up before the others can leave without it again.
+  // Every process must also have left the previous barrier, as the next one
+  // reuses its arrival counter and can't be reached without this one.
+  if (__atomic_load_n(&plrShm->quorumArriveMask[(gen+1) & 1], __ATOMIC_ACQUIRE) != 0
+      || __atomic_load_n(&plrShm->condWaitCnt[(gen+1) & 1], __ATOMIC_ACQUIRE) != 0) {
+    return 0;
+  }
+  
+  unsigned int mask = __atomic_load_n(&plrShm->quorumArriveMask[argsIdx], __ATOMIC_ACQUIRE);
+  if (__builtin_popcount(mask) < quorum || mask == allBits) {
+    return 0;
+  }
+  // The master action can't run without the master
+  if (actionType == WAIT_ACTION_MASTER && !(mask & 1)) {
+    return 0;
+  }
+  
+  // All present processes must agree, any disagreement is left to the
+  // regular vote once everyone arrived
+  int firstIdx = __builtin_ctz(mask);
+  for (int i = firstIdx+1; i < plrShm->nProc; ++i) {
+    if ((mask & (1u << i)) && plr_compareProcArgs(firstIdx, i, argsIdx) != 0) {
+      return 0;
+    }
+  }
+  
+  // Fails if another process arrived in the meantime, in which case it
+  // either completes the barrier or tries for a quorum itself
+  if (!__atomic_compare_exchange_n(&plrShm->quorumArriveMask[argsIdx], &mask, mask | PLR_QUORUM_CLOSED,
+                                   0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    return 0;
+  }
+  int claimed = plr_futexClaimBarrier(gen);
+  assert(claimed);
+  plrlog(LOG_DEBUG, "[%d] Quorum release of barrier %u (arrived 0x%X)\n", getpid(), gen, mask);
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Wait for a barrier closed by a quorum to complete, without counting as
+// arrived at it
+static void plr_quorumWaitLate(unsigned int lateGen) {
+  struct timespec relWait = tspecNewMs(plrShm->watchdogTimeout);
+  while (1) {
+    int futexVal = __atomic_load_n(&myProcShm->futexWord, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&plrShm->barrierGen, __ATOMIC_ACQUIRE) != lateGen) {
+      break;
+    }
+    __atomic_store_n(&myProcShm->futexParked, 1, __ATOMIC_SEQ_CST);
+    futex_wait(&myProcShm->futexWord, futexVal, &relWait);
+    __atomic_store_n(&myProcShm->futexParked, 0, __ATOMIC_RELAXED);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Returns 1 if the process left behind by a quorum at the barrier before
+// generation gen voted itself faulted, and every other process is waiting
+// at gen so it can be replaced.
+static int plr_quorumStragglerFaulted(unsigned int gen) {
+  if (!plrShm->quorum) {
+    return 0;
+  }
+  unsigned int prevMask = __atomic_load_n(&plrShm->quorumArriveMask[(gen+1) & 1], __ATOMIC_ACQUIRE);
+  if (!(prevMask & PLR_QUORUM_CLOSED)) {
+    return 0;
+  }
+  if (__atomic_load_n(&plrShm->condWaitCnt[gen & 1], __ATOMIC_ACQUIRE) != plrShm->nProc-1) {
+    return 0;
+  }
+  for (int i = 0; i < plrShm->nProc; ++i) {
+    if (!(prevMask & (1u << i))) {
+      return __atomic_load_n(&allProcShm[i].awaitingRepair, __ATOMIC_ACQUIRE);
+    }
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_waitBarrierTree(int (*actionPtr)(void), waitActionType_t actionType) {
+  // Ignore calls to plr_wait that come from the wrong pid, seems to
+  // occur when also instrumenting binary with Pin
+  if (myProcShm->pid != getpid()) {
+    return 0;
+  }
+  
+  // Mark this process as waiting at barrier. The arrival counter isn't used
+  // to detect completion here, but the watchdog relies on it to tell how
+  // many processes are missing.
+  unsigned int gen = __atomic_load_n(&plrShm->barrierGen, __ATOMIC_ACQUIRE);
+  int waitIdx = gen & 1;
+  myProcShm->waitIdx = waitIdx;
+  int waitCnt = __atomic_add_fetch(&plrShm->condWaitCnt[waitIdx], 1, __ATOMIC_ACQ_REL);
+  assert(waitCnt <= plrShm->nProc);
+  if (waitCnt == 1) {
+    plr_armWatchdog(gen);
+  } else if (waitCnt == plrShm->nProc) {
+    plr_recordArrivalSkew(gen);
+  }
+  
+  // Arrive once the whole subtree below this process has arrived, passing
+  // the arrival on to the tree parent. The root arriving means that every
+  // process has, so it claims the barrier and starts the action.
+  // arrivedAs tracks the slot this process arrived for, since a replacement
+  // process forked by the watchdog has to arrive for the slot it took over.
+  perProcData_t *arrivedAs = NULL;
+  int woken = 0;
+  while (1) {
+    // Same as the futex barrier, the futex word must be read before checking
+    // the exit & arrival conditions so no wakeup is lost
+    int futexVal = __atomic_load_n(&myProcShm->futexWord, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&plrShm->barrierGen, __ATOMIC_ACQUIRE) != gen) {
+      // Barrier completed, leave
+      break;
+    }
+    int actionIdx = __atomic_load_n(&plrShm->barrierActionIdx, __ATOMIC_ACQUIRE);
+    if (actionIdx >= 0 && &allProcShm[actionIdx] == myProcShm) {
+      // Barrier action was handed off to this process
+      woken = 0;
+      if (plr_futexRunAction(actionPtr, gen) < 0) {
+        myProcShm->waitIdx = -1;
+        __atomic_sub_fetch(&plrShm->condWaitCnt[waitIdx], 1, __ATOMIC_ACQ_REL);
+        exit(1);
+      }
+      continue;
+    }
+    if (arrivedAs != myProcShm && plr_treeSubtreeArrived(gen)) {
+      arrivedAs = myProcShm;
+      woken = 0;
+      __atomic_store_n(&myProcShm->treeArriveGen, gen+1, __ATOMIC_SEQ_CST);
+      
+      int myIdx = myProcShm - allProcShm;
+      if (myIdx != 0) {
+        plr_futexWakeProc(&allProcShm[(myIdx-1) / PLR_TREE_FANOUT]);
+      } else if (plr_futexClaimBarrier(gen)) {
+        if (plr_futexDispatchAction(actionPtr, actionType, gen) < 0) {
+          myProcShm->waitIdx = -1;
+          __atomic_sub_fetch(&plrShm->condWaitCnt[waitIdx], 1, __ATOMIC_ACQ_REL);
+          exit(1);
+        }
+      }
+      continue;
+    }
+    
+    // A process that died is replaced without waiting for the watchdog
+    int replaceNow = plr_deadProcessMissing(waitIdx);
+    if (!replaceNow) {
+      // Spin-then-park, children arriving & the release both bump the futex word
+      futexSpinCtx_t spinCtx = { .futexVal = futexVal };
+      if (plrShm->spinBudgetUs > 0 && plr_spinUntil(&plr_futexWordChanged, &spinCtx)) {
+        continue;
+      }
+      
+      if (woken) {
+        __atomic_add_fetch(&plrShm->spuriousWakeups, 1, __ATOMIC_RELAXED);
+        woken = 0;
+      }
+      
+      struct timespec deadline = plr_watchdogDeadline(gen);
+      __atomic_store_n(&myProcShm->futexParked, 1, __ATOMIC_SEQ_CST);
+      int waitRet = futex_wait_abs(&myProcShm->futexWord, futexVal, &deadline);
+      int waitErr = errno;
+      __atomic_store_n(&myProcShm->futexParked, 0, __ATOMIC_RELAXED);
+      if (waitRet == 0) {
+        __atomic_add_fetch(&plrShm->barrierWakeups, 1, __ATOMIC_RELAXED);
+        woken = 1;
+        continue;
+      } else if (waitErr != ETIMEDOUT) {
+        continue;
+      }
+    }
+    
+    // Watchdog expired, handle it with the lock held like the futex barrier
+    pthread_mutex_lock(&plrShm->lock);
+    if (__atomic_load_n(&plrShm->barrierGen, __ATOMIC_ACQUIRE) != gen
+        || (replaceNow && !plr_deadProcessMissing(waitIdx))) {
+      // Barrier completed or dead process replaced while acquiring the lock
+      pthread_mutex_unlock(&plrShm->lock);
+      continue;
+    }
+    if (__atomic_load_n(&plrShm->condWaitCnt[waitIdx], __ATOMIC_ACQUIRE) == plrShm->nProc) {
+      // Everyone arrived, the arrival is still on its way up the tree or the
+      // action is being handed off. Nothing is stuck, so rearm the watchdog.
+      plr_armWatchdog(gen);
+      pthread_mutex_unlock(&plrShm->lock);
+      continue;
+    }
+    int ret = plr_watchdogExpired();
+    if (ret == 1) {
+      // Give the replacement process a full watchdog interval
+      plr_armWatchdog(gen);
+    }
+    pthread_mutex_unlock(&plrShm->lock);
+    if (ret < 0) {
+      myProcShm->waitIdx = -1;
+      __atomic_sub_fetch(&plrShm->condWaitCnt[waitIdx], 1, __ATOMIC_ACQ_REL);
+      exit(1);
+    } else if (ret == 1) {
+      // Forked new process to replace stuck one. The replacement arrives for
+      // its slot on the next pass through the loop, completing the tree.
+    }
+  }
+  
+  // Pass the release on down the tree
+  plr_treeWakeChildren();
+  
+  // Decrement waiting process counter
+  __atomic_sub_fetch(&plrShm->condWaitCnt[waitIdx], 1, __ATOMIC_ACQ_REL);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Returns 1 if all tree children of the calling process have arrived at
+// barrier generation gen.
+static int plr_treeSubtreeArrived(unsigned int gen) {
+  int myIdx = myProcShm - allProcShm;
+  for (int i = 1; i <= PLR_TREE_FANOUT; ++i) {
+    int childIdx = myIdx*PLR_TREE_FANOUT + i;
+    if (childIdx >= plrShm->nProc) {
+      break;
+    }
+    if (__atomic_load_n(&allProcShm[childIdx].treeArriveGen, __ATOMIC_ACQUIRE) != gen+1) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_treeWakeChildren() {
+  int myIdx = myProcShm - allProcShm;
+  for (int i = 1; i <= PLR_TREE_FANOUT; ++i) {
+    int childIdx = myIdx*PLR_TREE_FANOUT + i;
+    if (childIdx >= plrShm->nProc) {
+      break;
+    }
+    plr_futexWakeProc(&allProcShm[childIdx]);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Returns 1 if the calling process won the right to complete barrier
+// generation gen, 0 if another process already claimed it.
+static int plr_futexClaimBarrier(unsigned int gen) {
+  unsigned int expected = gen;
+  return __atomic_compare_exchange_n(&plrShm->barrierClaimGen, &expected, gen+1,
+                                     0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Called by the process that claimed barrier generation gen. Either runs the
+// barrier action here or hands it off to the process that must run it.
+static int plr_futexDispatchAction(int (*actionPtr)(void), waitActionType_t actionType, unsigned int gen) {
+  if (!actionPtr) {
+    // No action function ptr provided, all processes can leave right away
+    plr_futexCompleteBarrier(gen);
+    return 0;
   }
   
-  pthread_mutex_unlock(&plrShm->lock);
+  int myIdx = myProcShm - allProcShm;
+  int runIdx = myIdx;
+  switch (actionType) {
+  case WAIT_ACTION_ANY:
+    break;
+  case WAIT_ACTION_MASTER:
+    runIdx = 0;
+    break;
+  case WAIT_ACTION_SLAVE:
+    runIdx = (myIdx == 0) ? 1 : myIdx;
+    break;
+  }
   
+  if (runIdx == myIdx) {
+    return plr_futexRunAction(actionPtr, gen);
+  }
+  plr_futexHandoffAction(runIdx);
   return 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-int plr_checkSyscallArgs(const syscallArgs_t *args) {
-  // Copy syscall arguments to shared memory area
-  memcpy(&myProcShm->syscallArgs, args, sizeof(syscallArgs_t));
+static int plr_futexRunAction(int (*actionPtr)(void), unsigned int gen) {
+  // The action may modify shared data (e.g. extraShm) or fork replacement
+  // processes, both of which expect plrShm->lock to be held
+  pthread_mutex_lock(&plrShm->lock);
+  __atomic_store_n(&plrShm->barrierActionIdx, -1, __ATOMIC_RELEASE);
   
-  // Wait for all processes to reach this barrier, then compare all syscall arguments
-  if (plr_waitBarrier(&plr_checkSyscallArgs_act, WAIT_ACTION_ANY) < 0) {
-    plrlog(LOG_ERROR, "Error: plr_waitBarrier failed\n");
-    exit(1);
+  int ret = actionPtr();
+  if (ret < 0) {
+    pthread_mutex_unlock(&plrShm->lock);
+    return -1;
+  } else if (ret == 0) {
+    // A replacement process forked inside the action also returns here,
+    // after the original process already completed the barrier
+    if (__atomic_load_n(&plrShm->barrierGen, __ATOMIC_ACQUIRE) == gen) {
+      plr_futexCompleteBarrier(gen);
+    }
+  } else {
+    // Rerun action on next sequential process
+    for (int i = 0; i < plrShm->nProc; ++i) {
+      if (myProcShm != &allProcShm[i]) {
+        plr_futexHandoffAction(i);
+        break;
+      }
+    }
   }
   
+  pthread_mutex_unlock(&plrShm->lock);
   return 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-// Barrier action for plr_checkSyscallArgs()
-int plr_checkSyscallArgs_act() {
-  // TODO: Temporarily assuming 3 redundant processes
-  assert(plrShm->nProc == 3);
-  
-  // Compare 1st & 2nd and 2nd & 3rd process syscall arguments
-  int comp0vs1 = plrC_compareArgs(&allProcShm[0].syscallArgs, 
-                                  &allProcShm[1].syscallArgs);
-  int comp1vs2 = plrC_compareArgs(&allProcShm[1].syscallArgs, 
-                                  &allProcShm[2].syscallArgs);
+static void plr_futexHandoffAction(int idx) {
+  __atomic_store_n(&plrShm->barrierActionIdx, idx, __ATOMIC_RELEASE);
+  plr_futexWakeProc(&allProcShm[idx]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_futexCompleteBarrier(unsigned int gen) {
+  // Subsequent barriers use the other wait counter
+  plrShm->curWaitIdx = (gen+1) & 1;
+  for (int i = 0; i < plrShm->nProc; ++i) {
+    allProcShm[i].waitIdx = -1;
+  }
+  // Every process arrived, reset quorum arrivals for reuse. A barrier closed
+  // by a quorum is reset by the late process instead.
+  if (!(__atomic_load_n(&plrShm->quorumArriveMask[gen & 1], __ATOMIC_ACQUIRE) & PLR_QUORUM_CLOSED)) {
+    __atomic_store_n(&plrShm->quorumArriveMask[gen & 1], 0, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&plrShm->barrierGen, gen+1, __ATOMIC_RELEASE);
   
-  // Check for faulted processes based on argument comparisons
-  int badProc;
-  if (comp0vs1 == 0 && comp1vs2 == 0) {
-    // All arguments agree
-    badProc = -1;
-  } else {
-    // Some arguments disagree
-    int comp0vs2 = plrC_compareArgs(&allProcShm[0].syscallArgs,
-                                    &allProcShm[2].syscallArgs);
-                                    
-    if (comp0vs1 > 0 && comp1vs2 == 0) {
-      // Proc 0 disagrees with 1 & 2
-      badProc = 0;
-    } else if (comp0vs1 > 0 && comp0vs2 == 0) {
-      // Proc 1 disagrees with 0 & 2
-      badProc = 1;
-    } else if (comp0vs2 > 0 && comp0vs1 == 0) {
-      // Proc 2 disagrees with 0 & 1
-      badProc = 2;
-    } else {
-      // All processes disagree
-      badProc = plrShm->nProc;
+  if (plrShm->barrierMode == PLR_BARRIER_TREE) {
+    // Only wake the root, every process wakes its tree children on leaving
+    if (myProcShm != &allProcShm[0]) {
+      plr_futexWakeProc(&allProcShm[0]);
     }
+    return;
   }
   
-  if (badProc == -1) {
-    // All arguments agree, nothing to do
-    return 0;
-  } else if (badProc >= 0 && badProc < plrShm->nProc) {
-    if (myProcShm == &allProcShm[badProc]) {
-      // Detected current process as faulted, need to rerun action on
-      // a different (good) process so it can be replaced
-      plrlog(LOG_DEBUG, "[%d] Current process is bad!\n", getpid());
-      return 1;
-    } else {
-      // Replace bad process with copy of current process
-      plrlog(LOG_DEBUG, "[%d] Replacing faulted pid %d\n", getpid(), allProcShm[badProc].pid);
-      if (plr_replaceProcessIdx(badProc) < 0) {
-        plrlog(LOG_ERROR, "Error: plr_replaceProcessIdx failed\n");
-        return -1;
-      }
-      return 0;
+  // Wake up all other processes
+  for (int i = 0; i < plrShm->nProc; ++i) {
+    if (myProcShm != &allProcShm[i]) {
+      plr_futexWakeProc(&allProcShm[i]);
     }
-  } else {
-    // Multiple disagreements detected
-    plrlog(LOG_DEBUG, "[%d] No processes agree with each other! Unrecoverable fault\n", getpid());
-    return -1;
   }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-int plr_isMasterProcess() {
-  // Whichever process is index 0 in allProcShm is treated as the 
-  // "master process"
-  if (myProcShm == &allProcShm[0]) {
-    return 1;
-  } else {
-    return 0;
+static void plr_futexWakeProc(perProcData_t *procShm) {
+  // Sequentially consistent so that either the waiter sees the new futex
+  // word, or this sees futexParked set and issues the wake
+  __atomic_add_fetch(&procShm->futexWord, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&procShm->futexParked, __ATOMIC_SEQ_CST)) {
+    futex_wake(&procShm->futexWord, 1);
   }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-int plr_masterAction(int (*actionPtr)(void)) {
-  // Wait for all processes to reach this barrier, then master process will
-  // run the provided function
-  if (plr_waitBarrier(actionPtr, WAIT_ACTION_MASTER) < 0) {
-    plrlog(LOG_ERROR, "Error: plr_waitBarrier failed\n");
-    exit(1);
+static void plr_armWatchdog(unsigned int gen) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  unsigned long long val = ((unsigned long long)tspecToNs(now) << 2) | (gen & 3);
+  __atomic_store_n(&plrShm->watchdogArmed[gen & 1], val, __ATOMIC_RELEASE);
+}
+
+static struct timespec plr_watchdogDeadline(unsigned int gen) {
+  unsigned long long val = __atomic_load_n(&plrShm->watchdogArmed[gen & 1], __ATOMIC_ACQUIRE);
+  struct timespec armed;
+  if ((val & 3) == (gen & 3) && val != 0) {
+    armed = tspecFromNs(val >> 2);
+  } else {
+    clock_gettime(CLOCK_MONOTONIC, &armed);
   }
-  
-  return 0;
+  return tspecAddMs(armed, plr_watchdogTimeoutMs());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-int plr_copyToShm(const void *src, size_t length, size_t offset) {
-  // First resize extraShm area so that it's at least as big as needed
-  if (plrSD_resizeExtraShm(offset+length) < 0) {
-    plrlog(LOG_ERROR, "[%d] Error: plrSD_resizeExtraShm failed\n", getpid());
-    exit(1);
+static void plr_setWatchdogCallType(void *addr) {
+  watchdogStats_t *stats = plrShm->watchdogStats;
+  if (stats[g_watchdogStatsIdx].addr == addr) {
+    return;
   }
   
-  // Refresh this process's extraShm mapping
-  if (plrSD_refreshExtraShm() < 0) {
-    plrlog(LOG_ERROR, "[%d] Error: plrSD_refreshExtraShm failed\n", getpid());
-    exit(1);
+  // Find the call type's entry or claim a free one. Entries are never freed,
+  // so an entry found claimed by another process keeps its call type.
+  g_watchdogStatsIdx = 0;
+  for (int i = 1; i < PLR_WATCHDOG_CALL_TYPES; ++i) {
+    void *entryAddr = __atomic_load_n(&stats[i].addr, __ATOMIC_ACQUIRE);
+    if (entryAddr == NULL) {
+      __atomic_compare_exchange_n(&stats[i].addr, &entryAddr, addr, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+    if (entryAddr == NULL || entryAddr == addr) {
+      g_watchdogStatsIdx = i;
+      return;
+    }
   }
-  
-  // Copy data into extraShm at specified offset
-  memcpy(extraShm+offset, src, length);
-  return 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-int plr_copyFromShm(void *dest, size_t length, size_t offset) {
-  // Refresh this process's extraShm mapping
-  if (plrSD_refreshExtraShm() < 0) {
-    plrlog(LOG_ERROR, "[%d] Error: plrSD_refreshExtraShm failed\n", getpid());
-    exit(1);
+static void plr_recordArrivalSkew(unsigned int gen) {
+  if (!plrShm->watchdogPercentile) {
+    return;
+  }
+  unsigned long long val = __atomic_load_n(&plrShm->watchdogArmed[gen & 1], __ATOMIC_ACQUIRE);
+  if ((val & 3) != (gen & 3) || val == 0) {
+    return;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long long skewUs = (tspecToNs(now) - (long long)(val >> 2)) / 1000;
+  int bucket = 0;
+  while (bucket < PLR_WATCHDOG_SKEW_BUCKETS-1 && skewUs >= (2LL << bucket)) {
+    ++bucket;
   }
   
-  // Copy data from extraShm at specified offset
-  memcpy(dest, extraShm+offset, length);
-  return 0;
-}
-
-///////////////////////////////////////////////////////////////////////////////
-void plr_setInsidePLR() {
-  assert(myProcShm);
-  assert(!myProcShm->insidePLR);
-  myProcShm->insidePLR = 1;
+  // Only the last process to arrive records, so a single process updates
+  // the call type's entry at a time. Old samples are aged out by halving
+  // them, so the timeout follows changes in the skew.
+  watchdogStats_t *stats = &plrShm->watchdogStats[g_watchdogStatsIdx];
+  stats->skewHist[bucket]++;
+  if (++stats->samples >= PLR_WATCHDOG_MAX_SAMPLES) {
+    stats->samples = 0;
+    for (int i = 0; i < PLR_WATCHDOG_SKEW_BUCKETS; ++i) {
+      stats->skewHist[i] /= 2;
+      stats->samples += stats->skewHist[i];
+    }
+  }
+  if (stats->samples < PLR_WATCHDOG_MIN_SAMPLES) {
+    return;
+  }
+  
+  long timeoutMs = (plr_skewPercentileUs(stats)*plrShm->watchdogMultiple + 999) / 1000;
+  if (timeoutMs < plrShm->watchdogMinTimeout) {
+    timeoutMs = plrShm->watchdogMinTimeout;
+  } else if (timeoutMs > plrShm->watchdogTimeout) {
+    timeoutMs = plrShm->watchdogTimeout;
+  }
+  __atomic_store_n(&stats->timeoutMs, timeoutMs, __ATOMIC_RELAXED);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void plr_clearInsidePLR() {
-  assert(myProcShm);
-  assert(myProcShm->insidePLR);
-  myProcShm->insidePLR = 0;
+// Skew at the configured percentile, rounded up to the end of its bucket
+static long long plr_skewPercentileUs(const watchdogStats_t *stats) {
+  unsigned int rank = ((unsigned long long)stats->samples*plrShm->watchdogPercentile + 99) / 100;
+  unsigned int count = 0;
+  int bucket = 0;
+  for (; bucket < PLR_WATCHDOG_SKEW_BUCKETS-1; ++bucket) {
+    count += stats->skewHist[bucket];
+    if (count >= rank) {
+      break;
+    }
+  }
+  return 2LL << bucket;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-int plr_checkInsidePLR() {
-  assert(g_insidePLRInternal || myProcShm);
-  return g_insidePLRInternal || myProcShm->insidePLR;
+static long plr_watchdogTimeoutMs() {
+  if (!plrShm->watchdogPercentile) {
+    return plrShm->watchdogTimeout;
+  }
+  long timeoutMs = __atomic_load_n(&plrShm->watchdogStats[g_watchdogStatsIdx].timeoutMs, __ATOMIC_RELAXED);
+  return (timeoutMs > 0) ? timeoutMs : plrShm->watchdogTimeout;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-int plr_waitBarrier(int (*actionPtr)(void), waitActionType_t actionType) {
-  pthread_mutex_lock(&plrShm->lock);
-  
-  // Ignore calls to plr_wait that come from the wrong pid, seems to
-  // occur when also instrumenting binary with Pin
-  if (myProcShm->pid != getpid()) {
-    pthread_mutex_unlock(&plrShm->lock);
+static int plr_deadProcessMissing(int waitIdx) {
+  if (__atomic_load_n(&plrShm->condWaitCnt[waitIdx], __ATOMIC_ACQUIRE) != plrShm->nProc-1) {
     return 0;
   }
-  
-  // Mark this process as waiting at barrier
-  int waitIdx = plrShm->curWaitIdx;
-  assert(plrShm->condWaitCnt[waitIdx] <= plrShm->nProc);
-  myProcShm->waitIdx = waitIdx;
-  plrShm->condWaitCnt[waitIdx]++;
-  
-  // If this isn't the first process to wait, wake up all other waiting
-  // processes so their timers restart (to avoid early watchdog timeout)
-  if (plrShm->condWaitCnt[waitIdx] > 1 && plrShm->condWaitCnt[waitIdx] < plrShm->nProc) {
-    for (int i = 0; i < plrShm->nProc; ++i) {
-      // pthread_cond_signal does nothing if no threads waiting on it,
-      // so safe to call on all procs, waiting or not
-      pthread_cond_signal(&allProcShm[i].cond[waitIdx]);
+  for (int i = 0; i < plrShm->nProc; ++i) {
+    if (__atomic_load_n(&allProcShm[i].died, __ATOMIC_ACQUIRE)
+        && __atomic_load_n(&allProcShm[i].waitIdx, __ATOMIC_ACQUIRE) < 0) {
+      return 1;
     }
   }
+  return 0;
+}
+
+static int plr_replaceWithoutWatchdog(unsigned int gen) {
+  return plr_deadProcessMissing(gen & 1) || plr_quorumStragglerFaulted(gen);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline void plr_cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+static int plr_spinUntil(int (*condFn)(void *), void *ctx) {
+  struct timespec now, spinEnd;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  spinEnd = tspecAdd(now, tspecNew(0, plrShm->spinBudgetUs*1000));
   
-  // Wait until all processes have reached this barrier
-  int watchdogExpired = 0;
+  // Back off exponentially between polls to limit coherence traffic on the
+  // polled cache line, up to a cap that keeps wakeup latency low
+  int backoff = 1;
   while (1) {
-    // Check barrier exit conditions
-    if (myProcShm->waitIdx < 0) {
-      // Wait flag already cleared, break out of wait loop
-      break;
+    if (condFn(ctx)) {
+      return 1;
     }
-    if (myProcShm->waitIdx >= 0 && plrShm->condWaitCnt[waitIdx] == plrShm->nProc) {
-      // Exit condition is met but wait flag has not been removed
-      // Call barrier action through provided function ptr now that all
-      // processes are synchronized & waiting at the barrier
-      int actionSuccess = 0;
-      if (actionPtr) {
-        int runAction = 0;
-        
-        switch (actionType) {
-        case WAIT_ACTION_ANY:
-          runAction = 1;
-          break;
-        case WAIT_ACTION_MASTER:
-          if (plr_isMasterProcess()) {
-            runAction = 1;
-          } else {
-            // Wake up master process so it can run action
-            pthread_cond_signal(&allProcShm[0].cond[waitIdx]);
-          }
-          break;
-        case WAIT_ACTION_SLAVE:
-          if (plr_isMasterProcess()) {
-            // Wake up a slave process so it can run action
-            pthread_cond_signal(&allProcShm[1].cond[waitIdx]);
-          } else {
-            runAction = 1;
-          }
-        }
-        
-        if (runAction) {
-          int ret = actionPtr();
-          if (ret < 0) {
-            myProcShm->waitIdx = -1;
-            plrShm->condWaitCnt[waitIdx]--;
-            pthread_mutex_unlock(&plrShm->lock);
-            exit(1);
-          } else if (ret == 0) {
-            actionSuccess = 1;
-          } else {
-            // Signal another process to wake up & run action
-            for (int i = 0; i < plrShm->nProc; ++i) {
-              if (myProcShm != &allProcShm[i]) {
-                pthread_cond_signal(&allProcShm[i].cond[waitIdx]);
-                break;
-              }
-            }
-          }
-        }
-      } else {
-        // No action function ptr provided, default success once exit condition met
-        actionSuccess = 1;
-      }
-      
-      // If barrier action succeeds, wake up all other processes & leave barrier
-      if (actionSuccess) {
-        if (myProcShm->waitIdx >= 0) {
-          // Shift curWaitIdx to other value so subsequent plr_wait calls use the
-          // other condition variable
-          plrShm->curWaitIdx = (plrShm->curWaitIdx) ? 0 : 1;
-          
-          // Reset all wait flags and wake up all other processes
-          //printf("[%d] Signaling all processes to wake up for idx %d\n", getpid(), waitIdx);
-          for (int i = 0; i < plrShm->nProc; ++i) {
-            pthread_cond_signal(&allProcShm[i].cond[waitIdx]);
-            allProcShm[i].waitIdx = -1;
-          }
-        }
-        
-        // Break out of wait loop
-        break;
-      }
+    for (int i = 0; i < backoff; ++i) {
+      plr_cpuRelax();
     }
-    
-    // Check if watchdog expired
-    if (watchdogExpired) {
-      int ret = plr_watchdogExpired();
-      if (ret < 0) {
-        myProcShm->waitIdx = -1;
-        plrShm->condWaitCnt[waitIdx]--;
-        pthread_mutex_unlock(&plrShm->lock);
-        exit(1);
-      } else if (ret == 1) {
-        // Forked new process to replace stuck one, check barrier exit condition again
-        continue;
-      }
+    if (backoff < 64) {
+      backoff *= 2;
     }
     
-    // Must use CLOCK_REALTIME, _timedwait needs abstime since epoch
-    struct timespec absWait;
-    clock_gettime(CLOCK_REALTIME, &absWait);
-    absWait = tspecAddMs(absWait, plrShm->watchdogTimeout);
-        
-    // Using _timedwait as a watchdog timer, to avoid deadlock in case one of the
-    // redundant processes has died or is stuck
-    // NOTE: This ignores the case of pthread_cond_timedwait returning EINTR, in
-    // which case less time than specified has elapsed. This can result in a longer
-    // than desired wait time because timer may just restart.
-
-    int ret = pthread_cond_timedwait(&myProcShm->cond[waitIdx], &plrShm->lock, &absWait);
-    if (ret == ETIMEDOUT) {
-      // Loop again to make sure timer didn't expire while last proc was waiting
-      watchdogExpired = 1; 
-    } else if (ret != 0) {
-      plrlog(LOG_ERROR, "[%d] pthread_cond_timedwait returned %d\n", getpid(), ret);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec > spinEnd.tv_sec || (now.tv_sec == spinEnd.tv_sec && now.tv_nsec >= spinEnd.tv_nsec)) {
+      return condFn(ctx);
     }
   }
-  
-  // Decrement waiting process counter
-  plrShm->condWaitCnt[waitIdx]--;
-  
-  pthread_mutex_unlock(&plrShm->lock);
-  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Barrier progressed if this process was released (waitIdx cleared), or if
+// another process arrived since spinning started, in which case this
+// process may need to run the barrier action
+static int plr_condBarrierProgressed(void *ctx) {
+  condSpinCtx_t *spinCtx = ctx;
+  return __atomic_load_n(&myProcShm->waitIdx, __ATOMIC_ACQUIRE) < 0
+      || __atomic_load_n(&plrShm->condWaitCnt[spinCtx->waitIdx], __ATOMIC_ACQUIRE) != spinCtx->waitCnt;
+}
+
+static int plr_futexWordChanged(void *ctx) {
+  futexSpinCtx_t *spinCtx = ctx;
+  return __atomic_load_n(&myProcShm->futexWord, __ATOMIC_ACQUIRE) != spinCtx->futexVal;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -510,9 +3530,14 @@ int plr_watchdogExpired() {
   int didReplace = 0;
   for (int i = 0; i < plrShm->nProc; ++i) {
     if (allProcShm[i].waitIdx < 0) {
-      plrlog(LOG_DEBUG, "[%d] Pid %d failed to wait before watchdog expired\n", myProcShm->pid, allProcShm[i].pid);
+      if (allProcShm[i].died) {
+        plrlog(LOG_DEBUG, "[%d] Pid %d died, replacing it\n", myProcShm->pid, allProcShm[i].pid);
+      } else {
+        plrlog(LOG_DEBUG, "[%d] Pid %d failed to wait before watchdog expired\n", myProcShm->pid, allProcShm[i].pid);
+      }
       plrShm->restoring = 1;
       didReplace = 1;
+      plr_adaptNoteFault();
       
       // Replace non-waiting process with a copy of the current process
       // Note that both the current & new processes will exit this function
@@ -525,7 +3550,11 @@ int plr_watchdogExpired() {
       // then this is the forked child. Do some setup on the new process.
       if (myProcShm == &allProcShm[i]) {
         myProcShm->waitIdx = plrShm->curWaitIdx;
-        plrShm->condWaitCnt[waitIdx]++;
+        // Atomic since the futex barrier counts arrivals without the lock
+        __atomic_add_fetch(&plrShm->condWaitCnt[waitIdx], 1, __ATOMIC_ACQ_REL);
+        // If the replaced process was left behind by a quorum, the new one
+        // already is past that barrier
+        __atomic_store_n(&plrShm->quorumArriveMask[(waitIdx+1) & 1], 0, __ATOMIC_RELEASE);
         plrShm->restoring = 0;
         plrlog(LOG_DEBUG, "[%d] Watchdog replacement process started\n", myProcShm->pid);
       }
@@ -574,6 +3603,10 @@ int plr_forkNewProcess(perProcData_t *newProcShm) {
   perProcData_t parentProcShmCpy;
   memcpy(&parentProcShmCpy, myProcShm, sizeof(perProcData_t));
   
+  // Output actions of the master leave their data in its stdio buffers, the
+  // child would write it out a second time
+  fflush(NULL);
+  
   int childPid = fork();
   if (childPid < 0) {
     perror("fork");
@@ -588,7 +3621,16 @@ int plr_forkNewProcess(perProcData_t *newProcShm) {
     // Initialize this new proc's data area
     myProcShm = newProcShm;
     plrSD_initProcDataAsCopy(myProcShm, &parentProcShmCpy);
+    plr_notifyFigurehead();
   }
   
   return 0;
 }
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plr_notifyFigurehead() {
+  if (plrShm->figureheadPid > 0) {
+    kill(plrShm->figureheadPid, PLR_FIGUREHEAD_WATCH_SIGNAL);
+  }
+}
@@ -5,7 +5,57 @@ extern "C" {
 #endif
 
 #include <sys/types.h>
+#include <signal.h>
 #include "plrCompare.h"
+#include "plrHash.h"
+
+typedef enum {
+  // Barrier built on plrShm->lock and per-process condition variables
+  PLR_BARRIER_COND,
+  // Lock-free barrier built on atomic arrival counters and futexes
+  PLR_BARRIER_FUTEX,
+  // Futex barrier where arrivals are combined & the release is passed on
+  // along a tree of processes, so each process only wakes a fixed number of
+  // others and latency grows logarithmically with the number of processes
+  PLR_BARRIER_TREE
+} plrBarrierMode_t;
+
+typedef enum {
+  // Redundant processes check each other
+  PLR_LOG_OFF,
+  // Only one process runs, & every checked syscall is appended to a log
+  PLR_LOG_RECORD,
+  // Every process checks its syscalls against a log & uses its results
+  PLR_LOG_VERIFY
+} plrLogMode_t;
+
+// Exit status of plr when it detected a fault it couldn't correct
+#define PLR_FAULT_EXIT_STATUS 3
+
+// Default to the tree barrier from this many redundant processes on
+#define PLR_TREE_BARRIER_MIN_PROC 5
+
+// Number of redundant processes adaptive redundancy drops to while no
+// faults are seen, detection only
+#define PLR_ADAPT_MIN_PROC 2
+
+// Number of checkpoints kept by default with checkpointing
+#define PLR_CKPT_DEFAULT_RETAIN 2
+
+// Default percentage of the run time plr_check() may spend hashing
+#define PLR_CHECK_DEFAULT_BUDGET 10
+
+// Stand-ins for the libc offset in the arguments of checked calls that
+// aren't libc calls, which no libc function has
+#define PLR_ADDR_PAUSE  ((void*)1)
+#define PLR_ADDR_RESUME ((void*)2)
+#define PLR_ADDR_CHECK  ((void*)3)
+#define PLR_ADDR_SCRUB  ((void*)4)
+#define PLR_ADDR_EXIT   ((void*)5)
+
+// Sent to the figurehead by every redundant process once it took its slot
+// in the shared data area, so the figurehead starts watching its PID
+#define PLR_FIGUREHEAD_WATCH_SIGNAL SIGUSR1
 
 // Update the global shared data variables (if needed)
 void plr_refreshSharedData();
@@ -13,6 +63,146 @@ void plr_refreshSharedData();
 int plr_figureheadInit(int nProc, int pintoolMode, int pid, long watchdogTimeoutMs);
 int plr_figureheadExit();
 
+// Select the barrier implementation used by all PLR processes. Shall be
+// called by the figurehead after plr_figureheadInit and before the first
+// redundant process is started.
+int plr_figureheadSetBarrierMode(plrBarrierMode_t mode);
+
+// Set how long processes busy-poll at a barrier before sleeping in the
+// kernel, in microseconds. Intended for hosts where each redundant process
+// has a dedicated core. The budget is capped to the watchdog timeout so
+// that the watchdog keeps firing on time. Same calling rules as
+// plr_figureheadSetBarrierMode.
+int plr_figureheadSetSpinBudget(long spinBudgetUs);
+
+// Enable quorum release of checked actions. Once a majority of processes
+// arrived at plr_checkedMasterAction/plr_checkedExecutorAction with
+// matching arguments, the action runs and the majority continues. A late
+// process validates its arguments against theirs when it arrives, and is
+// replaced if they disagree or if it hasn't caught up by the time the
+// others finished waiting at the next barrier (watchdog timeout). Requires
+// the futex barrier. Same calling rules as plr_figureheadSetBarrierMode.
+int plr_figureheadSetQuorum(int enable);
+
+// Enable asynchronous mode, for throughput over latency. The master no
+// longer waits for the slaves at checked syscalls. It records its arguments
+// and the results of each action in a ring of up to lag entries and keeps
+// running, while the slaves check their own arguments against the ring &
+// use the recorded results, up to lag syscalls behind. A disagreement gets
+// the faulted process replaced from a process the other slave agrees with,
+// but anything a faulted master did before it was caught can't be undone.
+// A lag of 0 turns asynchronous mode off (the default), otherwise it
+// requires 3 redundant processes and no quorum mode. Same calling rules as
+// plr_figureheadSetBarrierMode.
+int plr_figureheadSetAsyncLag(int lag);
+
+// Set the epoch length for calls checked with plr_foldSyscallArgs(). Their
+// arguments are then folded into a hash & only compared every calls
+// folded calls, or at the next call that synchronizes right away. 0 checks
+// every call right away. Same calling rules as plr_figureheadSetBarrierMode.
+int plr_figureheadSetEpochLength(int calls);
+
+// Adaptive redundancy. The program starts out with PLR_ADAPT_MIN_PROC
+// redundant processes, and the group grows back to the number given to
+// plr_figureheadInit after a faulted process was replaced. Once no fault
+// was seen for cleanMs, the extra processes are retired again. Every fault
+// doubles that clean period (up to a limit) & every retirement halves it
+// (down to cleanMs), so frequent faults keep the group at full size longer.
+// Call before the first process is started, after the barrier mode,
+// quorum, asynchronous, record & verify mode setup.
+int plr_figureheadSetAdaptiveRedundancy(long cleanMs);
+
+// Checkpoint & rollback recovery. Every intervalMs, the master writes out
+// its stdio buffers & forks a frozen copy of itself at the start of a
+// checked syscall, once all earlier ones were verified. Besides the one
+// taken last, the newest retain (at most PLR_CKPT_MAX_RETAIN) of these
+// checkpoints are kept, since the one taken last is only verified along
+// with its syscall. The executors log every verified call with its results.
+// When the processes disagree with no majority to repair from, e.g. any
+// disagreement with 2 processes, the group is killed & the newest
+// checkpoint takes its place. It replays the logged calls against the log
+// like a verifier, so their output isn't repeated, & runs live after them.
+// Can't be combined with quorum, asynchronous, record or verify mode. Same
+// calling rules as plr_figureheadSetAdaptiveRedundancy.
+int plr_figureheadSetCheckpointing(long intervalMs, int retain);
+
+// Record mode. The single redundant process runs the program on its own &
+// appends every checked syscall, with its arguments & the results passed on
+// through plr_copyToShm(), to a call log created at path. Requires 1
+// redundant process. Call after all other setup, since the header of the
+// log keeps the settings that affect which calls get checked.
+int plr_figureheadSetRecordLog(const char *path);
+
+// Verify mode. Every redundant process re-runs the program against the
+// call log at path, checking its syscalls against the log & using the
+// recorded results instead of running the actions. Takes the getpid()
+// value, epoch length & output batching limit from the log.
+int plr_figureheadSetVerifyLog(const char *path);
+
+// Called once all redundant processes exited. Finishes the log of record
+// mode, or reports the verifiers that diverged from the log in verify mode.
+// Returns 0 on success, 1 if a verifier diverged, and -1 on failure.
+int plr_figureheadFinishLog();
+
+// Enable output batching. Output wrappers then queue their data per fd &
+// only check & write it out at flush points, or once limitBytes are
+// queued. 0 disables batching. Same calling rules as
+// plr_figureheadSetBarrierMode.
+int plr_figureheadSetOutputBatching(long limitBytes);
+
+// Set the percentage of the run time (1-100) that plr_check() calls of the
+// program may spend hashing, see plrApi.h. Calls are skipped as needed to
+// stay within it, 100 checks every call. Same calling rules as
+// plr_figureheadSetBarrierMode.
+int plr_figureheadSetCheckBudget(int percent);
+
+// Select the algorithm the wrappers hash data of class cls with, see
+// plrHash.h. Defaults to plrH_defaultAlgo(cls). Same calling rules as
+// plr_figureheadSetBarrierMode, and must come before the record mode setup,
+// which stores the selection in the log for verify mode.
+int plr_figureheadSetHashAlgorithm(plrHashClass_t cls, plrHashAlgo_t algo);
+
+// Memory scrubbing. Every interval checked syscalls, each redundant process
+// hashes the writable data segments of the program & the hash is checked
+// like the arguments of a syscall, so a process whose data was corrupted is
+// replaced before the corruption reaches a syscall. Only the pages written
+// since the last scrub are hashed again, found through the kernel's
+// soft-dirty bits, or all of them if the kernel doesn't track those. The
+// heap & stack aren't scrubbed, since the master's stdio buffers & PLR's
+// own state make them differ between the processes. Can't be combined
+// with record or verify mode. Same calling rules as
+// plr_figureheadSetAdaptiveRedundancy.
+int plr_figureheadSetScrubbing(int interval);
+
+// Enable the adaptive watchdog. Instead of the fixed watchdog timeout, each
+// barrier is timed with multiple times the given percentile of the arrival
+// skew observed at barriers of the same wrapped call, within minTimeoutMs
+// and the fixed timeout. The fixed timeout is used until enough skews were
+// observed. Same calling rules as plr_figureheadSetBarrierMode.
+int plr_figureheadSetAdaptiveWatchdog(int percentile, int multiple, long minTimeoutMs);
+
+// Write the arrival skew & adaptive watchdog timeout learned for each
+// wrapped call to the file at path, one line per call. Shall be called by
+// the figurehead after all redundant processes exited.
+int plr_figureheadWriteWatchdogStats(const char *path);
+
+// Returns 1 if the redundant processes detected a fault that they couldn't
+// correct & aborted, e.g. any disagreement with only 2 processes. plr then
+// exits with PLR_FAULT_EXIT_STATUS.
+int plr_figureheadFaultDetected();
+
+// Fill pids with the PID of the redundant process in each slot of the
+// shared data area, 0 for a free slot. Returns the number of slots (at most
+// maxProc are filled).
+int plr_figureheadGetProcPids(int *pids, int maxProc);
+
+// Called by the figurehead when the given PID has died. If it's still one
+// of the redundant processes, it's flagged dead and the other processes are
+// woken up, so they replace it as soon as they are all waiting at a barrier
+// instead of when the watchdog expires. Returns 1 if the process was
+// flagged, 0 if it wasn't a (live) redundant process, < 0 on error.
+int plr_figureheadProcessDied(int pid);
+
 // plr_processInit() should only be called once, by the first redundant
 // process started by the figurehead. It will acquire the shared data area
 // and fork the other redundant processes.
@@ -26,6 +216,40 @@ int plr_processInit();
 // of PLR's fault recovery capability), even if a faulted process enters.
 int plr_checkSyscallArgs(const syscallArgs_t *args);
 
+// Checks syscall arguments like plr_checkSyscallArgs(), then performs the
+// action on the master process like plr_masterAction(). When all arguments
+// agree, which is the common case, both happen in a single barrier: the
+// master votes and runs the action before any process is released. If a
+// fault is found the action isn't run, the faulted process is replaced,
+// and the action is then run in a second barrier.
+int plr_checkedMasterAction(const syscallArgs_t *args, int (*actionPtr)(void));
+
+// Same as plr_checkedMasterAction(), but the action runs on whichever
+// process arrives last, see plr_executorAction().
+int plr_checkedExecutorAction(const syscallArgs_t *args, int (*actionPtr)(void));
+
+// Folds args into a per-process hash that is compared between processes
+// along with the arguments of the next plr_checkSyscallArgs() or
+// plr_checkedMasterAction() call, instead of synchronizing right away.
+// Meant for consistency checks that don't guard an external action.
+void plr_deferSyscallArgsCheck(const syscallArgs_t *args);
+
+// Checks the arguments of a call without an external effect, which only has
+// to be compared before the next one that does. Within an epoch the
+// arguments are folded like plr_deferSyscallArgsCheck(), and the last call of
+// the epoch synchronizes like plr_checkSyscallArgs(). Without an epoch
+// length this is plr_checkSyscallArgs().
+int plr_foldSyscallArgs(const syscallArgs_t *args);
+
+// Compares the checks deferred or folded since the last checked call, which
+// no later call would compare, when the program exits. Every process makes
+// this last check, whether any are pending or not.
+int plr_checkDeferredAtExit();
+
+// Returns the epoch length for plr_foldSyscallArgs(), or 0 if every call
+// is checked right away.
+int plr_epochLength();
+
 // Check whether the current process is the master process or not.
 // Returns 1 if master, 0 if slave, and -1 on error.
 int plr_isMasterProcess();
@@ -37,6 +261,62 @@ int plr_isMasterProcess();
 // 0 if it completes normally.
 int plr_masterAction(int (*actionPtr)(void));
 
+// Same as plr_masterAction(), but the action runs on whichever process
+// arrives at the barrier last, which saves waking up the master process
+// just to run it. Only for actions whose effects are shared by all
+// processes (e.g. the file offset of an fd), not ones that leave state
+// behind in the executing process (e.g. buffered stdio output), since the
+// next action may run on a different process.
+int plr_executorAction(int (*actionPtr)(void));
+
+// Check whether the current process ran the action of the last
+// plr_masterAction(), plr_executorAction(), or checked variant call.
+// Returns 1 if it did, in which case it must publish the results for the
+// other processes, and 0 if it has to copy them from shared memory instead.
+int plr_isExecutorProcess();
+
+// Called from an action whose slave side touches a file the master can
+// change afterwards, like reopening it or reading at its EOF. In
+// asynchronous mode the master then waits at its next checked syscall
+// until the slaves are done with this one. No effect otherwise.
+void plr_waitForSlavesAfterAction();
+
+// Returns 1 if the process is verifying a call log. Verifiers must not
+// change any files, since the recorded run already did.
+int plr_isVerifying();
+
+// Returns 1 if the process is replaying logged calls after a rollback.
+// Their results come from the log, & files they reopen must not be
+// truncated again, since the rolled back run already wrote them.
+int plr_isReplaying();
+
+// Unprotected regions between plr_pause() & plr_resume() of the program,
+// see plrApi.h. While paused, plr_checkInsidePLR() returns 1, so the
+// wrappers call libc directly in every process.
+void plr_setPaused(int paused);
+int plr_isPaused();
+
+// Returns 1 if a wrapper of a call with an external effect, like output or
+// removing a file, should skip the call & return as if it succeeded. While
+// paused only the master has these effects, & verifiers & processes
+// replaying after a rollback have none since the earlier run had them.
+int plr_skipPausedEffect();
+
+// Returns the output batching limit in bytes, or 0 if batching is disabled.
+long plr_outputBatchLimit();
+
+// Returns the percentage of the run time plr_check() may spend hashing.
+int plr_checkBudget();
+
+// Hashes len bytes at buf with the algorithm selected for cls, continuing
+// from the digest seed (0 to start). Used for the arguments of checked
+// calls that are too long to compare directly, like strings & buffers.
+unsigned long plr_hash(plrHashClass_t cls, unsigned long seed, const void *buf, size_t len);
+// Copies len bytes from src to dest & returns their digest like plr_hash(),
+// in a single pass over the data. Used for data that's hashed on its way
+// into a buffer.
+unsigned long plr_copyHash(plrHashClass_t cls, unsigned long seed, void *dest, const void *src, size_t len);
+
 // These two functions are used to copy generic data into and out of an
 // area of process shared memory, which is allocated transparently based
 // on the offset and length arguments. Used for passing data between
@@ -48,6 +328,14 @@ int plr_copyToShm(const void *src, size_t length, size_t offset);
 // synchronized with other processes properly to get the expected data,
 // but plrShm->lock need not be held.
 int plr_copyFromShm(void *dest, size_t length, size_t offset);
+// Variants for buffers of results, like the data returned by reads, that
+// copy & hash the data in one pass. plr_copyToShmHashed() returns the
+// digest of the data, which the executor passes on along with its other
+// results. plr_copyFromShmChecked() checks the data against that digest
+// as it copies it, & exits the process if they differ, so it's replaced
+// with one that has good data.
+unsigned long plr_copyToShmHashed(const void *src, size_t length, size_t offset);
+int plr_copyFromShmChecked(void *dest, size_t length, size_t offset, unsigned long digest);
 
 // These functions are used to manage a per-process flag indicating whether
 // currently inside core PLR code. Used by the overriden system call 
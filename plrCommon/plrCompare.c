@@ -22,3 +22,14 @@ int plrC_compareArgs(const syscallArgs_t *args1, const syscallArgs_t *args2) {
   
   return faultVal;
 }
+
+unsigned long plrC_hashArgs(unsigned long hash, const syscallArgs_t *args) {
+  // FNV-1a style mixing, one 64-bit word at a time
+  const unsigned long prime = 0x100000001b3UL;
+  hash = (hash ^ (unsigned long)args->addr) * prime;
+  for (int i = 0; i < 6; ++i) {
+    hash = (hash ^ args->arg[i]) * prime;
+  }
+  // Keep a nonzero hash distinct from "nothing folded in"
+  return hash ? hash : 1;
+}
@@ -18,6 +18,10 @@ typedef struct {
 //   >= 1 : Arguments are different
 int plrC_compareArgs(const syscallArgs_t *args1, const syscallArgs_t *args2);
 
+// Folds the contents of a syscallArgs_t struct into a running hash value.
+// Start with a hash of 0. Equal sequences of arguments give equal hashes.
+unsigned long plrC_hashArgs(unsigned long hash, const syscallArgs_t *args);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,539 @@
+#include <stdint.h>
+#include <string.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "plrHash.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Global data
+
+// CRC32C (Castagnoli) polynomial, bit reversed
+#define PLRH_CRC32C_POLY 0x82f63b78
+// Bytes per stream of the interleaved crc32 instructions, in long blocks
+// first & short ones for the rest
+#define PLRH_CRC_LONG_BLOCK 4096
+#define PLRH_CRC_SHORT_BLOCK 256
+// Bytes hashed at a time by plrH_copyHash() before copying them
+#define PLRH_CRC_COPY_CHUNK (3*PLRH_CRC_LONG_BLOCK)
+
+// XXH3 style hash. Inputs longer than PLRH_XXH_MID_MAX are hashed in
+// stripes of 64 bytes, each mixed into 8 lanes with a secret that slides
+// by 8 bytes per stripe, & the lanes are scrambled after every block of
+// stripes that uses up the secret.
+#define PLRH_XXH_SECRET_SIZE 192
+#define PLRH_XXH_STRIPE 64
+#define PLRH_XXH_STRIPES_PER_BLOCK ((PLRH_XXH_SECRET_SIZE - PLRH_XXH_STRIPE) / 8)
+#define PLRH_XXH_MID_MAX 240
+
+#define PRIME32_1 0x9e3779b1U
+#define PRIME32_2 0x85ebca77U
+#define PRIME32_3 0xc2b2ae3dU
+#define PRIME64_1 0x9e3779b185ebca87ULL
+#define PRIME64_2 0xc2b2ae3d27d4eb4fULL
+#define PRIME64_3 0x165667b19e3779f9ULL
+#define PRIME64_4 0x85ebca77c2b2ae63ULL
+#define PRIME64_5 0x27d4eb2f165667c5ULL
+
+typedef uint32_t (*crcFn_t)(uint32_t crc, const unsigned char *buf, size_t len);
+// The xxh implementations also copy the data to dest as they go, unless
+// it's NULL
+typedef void (*xxhLongFn_t)(uint64_t *acc, unsigned char *dest, const unsigned char *buf, size_t len);
+typedef void (*xxhStripeFn_t)(uint64_t *acc, unsigned char *dest, const unsigned char *in, const unsigned char *secret);
+typedef void (*xxhScrambleFn_t)(uint64_t *acc, const unsigned char *secret);
+
+static const char *g_classNames[PLR_HASH_NCLASSES] = { "name", "data", "state" };
+static const char *g_algoNames[PLR_HASH_NALGOS] = { "crc32c", "xxh" };
+
+// Table for CRC32C lookups 8 bytes at a time, entry [k][b] is the CRC of
+// byte b followed by k zero bytes
+static uint32_t g_crcTable[8][256];
+// x^(8n-33) mod P for n = 1 & 2 stream lengths of the long & short blocks,
+// which shift a stream's CRC past the data of the streams after it
+static uint32_t g_crcShiftLong[2];
+static uint32_t g_crcShiftShort[2];
+static uint8_t g_xxhSecret[PLRH_XXH_SECRET_SIZE] __attribute__((aligned(64)));
+
+// Implementations picked for this CPU by plrH_init()
+static crcFn_t g_crc32c = NULL;
+static xxhLongFn_t g_xxhLong = NULL;
+static const char *g_crc32cImpl = "";
+static const char *g_xxhImpl = "";
+
+///////////////////////////////////////////////////////////////////////////////
+// Private functions
+
+static void plrH_init() __attribute__((constructor));
+static uint32_t plrH_crcMultModP(uint32_t a, uint32_t b);
+static uint32_t plrH_crcXPowModP(unsigned long n);
+static uint32_t plrH_crc32cTable(uint32_t crc, const unsigned char *buf, size_t len);
+static uint64_t plrH_xxh(uint64_t seed, unsigned char *dest, const unsigned char *buf, size_t len);
+static void plrH_xxhLongScalar(uint64_t *acc, unsigned char *dest, const unsigned char *buf, size_t len);
+#if defined(__x86_64__)
+static uint32_t plrH_crc32cSse42(uint32_t crc, const unsigned char *buf, size_t len);
+static uint32_t plrH_crc32cPclmul(uint32_t crc, const unsigned char *buf, size_t len);
+static void plrH_xxhLongSse2(uint64_t *acc, unsigned char *dest, const unsigned char *buf, size_t len);
+static void plrH_xxhLongAvx2(uint64_t *acc, unsigned char *dest, const unsigned char *buf, size_t len);
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t plrH_load64(const unsigned char *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t plrH_load32(const unsigned char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void plrH_store64(unsigned char *p, uint64_t v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned long plrH_hash(plrHashAlgo_t algo, unsigned long seed, const void *buf, size_t len) {
+  if (algo == PLR_HASH_CRC32C) {
+    return ~g_crc32c(~(uint32_t)seed, buf, len);
+  }
+  return plrH_xxh(seed, NULL, buf, len);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned long plrH_copyHash(plrHashAlgo_t algo, unsigned long seed, void *dest, const void *src, size_t len) {
+  if (algo == PLR_HASH_XXH) {
+    return plrH_xxh(seed, dest, src, len);
+  }
+  // Storing each word from the 3 crc32 streams is slower than copying a
+  // chunk with memcpy while it's still in L1 after hashing it
+  uint32_t crc = ~(uint32_t)seed;
+  for (size_t n; len != 0; len -= n) {
+    n = (len < PLRH_CRC_COPY_CHUNK) ? len : PLRH_CRC_COPY_CHUNK;
+    crc = g_crc32c(crc, src, n);
+    memcpy(dest, src, n);
+    dest = (char*)dest + n;
+    src = (const char*)src + n;
+  }
+  return ~crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+plrHashAlgo_t plrH_defaultAlgo(plrHashClass_t cls) {
+  // A crc32 instruction per 8 bytes has the lowest setup cost for short
+  // strings, the XXH3 lanes have the highest throughput for large buffers
+  return (cls == PLR_HASH_NAME) ? PLR_HASH_CRC32C : PLR_HASH_XXH;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+const char *plrH_className(plrHashClass_t cls) {
+  return g_classNames[cls];
+}
+
+const char *plrH_algoName(plrHashAlgo_t algo) {
+  return g_algoNames[algo];
+}
+
+int plrH_findClass(const char *name) {
+  for (int i = 0; i < PLR_HASH_NCLASSES; ++i) {
+    if (strcmp(name, g_classNames[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int plrH_findAlgo(const char *name) {
+  for (int i = 0; i < PLR_HASH_NALGOS; ++i) {
+    if (strcmp(name, g_algoNames[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+const char *plrH_implName(plrHashAlgo_t algo) {
+  return (algo == PLR_HASH_CRC32C) ? g_crc32cImpl : g_xxhImpl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plrH_init() {
+  for (int b = 0; b < 256; ++b) {
+    uint32_t crc = b;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc & 1) ? (crc >> 1) ^ PLRH_CRC32C_POLY : crc >> 1;
+    }
+    g_crcTable[0][b] = crc;
+  }
+  for (int b = 0; b < 256; ++b) {
+    for (int k = 1; k < 8; ++k) {
+      g_crcTable[k][b] = (g_crcTable[k-1][b] >> 8) ^ g_crcTable[0][g_crcTable[k-1][b] & 0xff];
+    }
+  }
+  for (int n = 1; n <= 2; ++n) {
+    g_crcShiftLong[n-1] = plrH_crcXPowModP(8UL*n*PLRH_CRC_LONG_BLOCK - 33);
+    g_crcShiftShort[n-1] = plrH_crcXPowModP(8UL*n*PLRH_CRC_SHORT_BLOCK - 33);
+  }
+
+  // Fixed secret, the same in every process & run
+  uint64_t state = PRIME64_1;
+  for (int i = 0; i < PLRH_XXH_SECRET_SIZE; i += 8) {
+    // splitmix64
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    memcpy(g_xxhSecret + i, &z, sizeof(z));
+  }
+
+  g_crc32c = plrH_crc32cTable;
+  g_crc32cImpl = "table";
+  g_xxhLong = plrH_xxhLongScalar;
+  g_xxhImpl = "scalar";
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul")) {
+    g_crc32c = plrH_crc32cPclmul;
+    g_crc32cImpl = "sse4.2+pclmul";
+  } else if (__builtin_cpu_supports("sse4.2")) {
+    g_crc32c = plrH_crc32cSse42;
+    g_crc32cImpl = "sse4.2";
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    g_xxhLong = plrH_xxhLongAvx2;
+    g_xxhImpl = "avx2";
+  } else {
+    g_xxhLong = plrH_xxhLongSse2;
+    g_xxhImpl = "sse2";
+  }
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Product of two polynomials mod P, bit reversed like the CRC
+static uint32_t plrH_crcMultModP(uint32_t a, uint32_t b) {
+  uint32_t prod = 0;
+  for (uint32_t m = 1U << 31; m != 0; m >>= 1) {
+    if (a & m) {
+      prod ^= b;
+    }
+    b = (b & 1) ? (b >> 1) ^ PLRH_CRC32C_POLY : b >> 1;
+  }
+  return prod;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint32_t plrH_crcXPowModP(unsigned long n) {
+  // Square & multiply, starting from x^0 & x^1
+  uint32_t pow = 1U << 31;
+  uint32_t sq = 1U << 30;
+  for (; n != 0; n >>= 1) {
+    if (n & 1) {
+      pow = plrH_crcMultModP(pow, sq);
+    }
+    sq = plrH_crcMultModP(sq, sq);
+  }
+  return pow;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint32_t plrH_crc32cTable(uint32_t crc, const unsigned char *buf, size_t len) {
+  for (; len != 0 && ((uintptr_t)buf & 7) != 0; --len) {
+    crc = g_crcTable[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+  }
+  for (; len >= 8; len -= 8, buf += 8) {
+    uint64_t w = plrH_load64(buf) ^ crc;
+    crc = g_crcTable[7][w & 0xff] ^ g_crcTable[6][(w >> 8) & 0xff]
+        ^ g_crcTable[5][(w >> 16) & 0xff] ^ g_crcTable[4][(w >> 24) & 0xff]
+        ^ g_crcTable[3][(w >> 32) & 0xff] ^ g_crcTable[2][(w >> 40) & 0xff]
+        ^ g_crcTable[1][(w >> 48) & 0xff] ^ g_crcTable[0][w >> 56];
+  }
+  for (; len != 0; --len) {
+    crc = g_crcTable[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2")))
+static uint32_t plrH_crc32cSse42(uint32_t crc, const unsigned char *buf, size_t len) {
+  for (; len != 0 && ((uintptr_t)buf & 7) != 0; --len) {
+    crc = _mm_crc32_u8(crc, *buf++);
+  }
+  uint64_t crc64 = crc;
+  for (; len >= 8; len -= 8, buf += 8) {
+    crc64 = _mm_crc32_u64(crc64, plrH_load64(buf));
+  }
+  crc = crc64;
+  for (; len != 0; --len) {
+    crc = _mm_crc32_u8(crc, *buf++);
+  }
+  return crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Multiplies crc by shift, x^(8n-33) mod P, with a carry-less multiply. The
+// 64-bit product is reduced by a crc32 instruction, which multiplies by the
+// missing x^33.
+__attribute__((target("sse4.2,pclmul")))
+static inline uint32_t plrH_crcShift(uint32_t crc, uint32_t shift) {
+  __m128i prod = _mm_clmulepi64_si128(_mm_cvtsi32_si128(crc), _mm_cvtsi32_si128(shift), 0);
+  return _mm_crc32_u64(0, _mm_cvtsi128_si64(prod));
+}
+
+// CRC of 3 consecutive blocks of blockLen bytes. A single crc32 stream is
+// bound by the instruction's latency, 3 independent ones by its throughput.
+__attribute__((target("sse4.2,pclmul"), always_inline))
+static inline uint32_t plrH_crc3Blocks(uint32_t crc, const unsigned char *buf, size_t blockLen, const uint32_t *shift) {
+  uint64_t crc0 = crc;
+  uint64_t crc1 = 0;
+  uint64_t crc2 = 0;
+  for (size_t i = 0; i < blockLen; i += 8) {
+    crc0 = _mm_crc32_u64(crc0, plrH_load64(buf + i));
+    crc1 = _mm_crc32_u64(crc1, plrH_load64(buf + blockLen + i));
+    crc2 = _mm_crc32_u64(crc2, plrH_load64(buf + 2*blockLen + i));
+  }
+  return plrH_crcShift(crc0, shift[1]) ^ plrH_crcShift(crc1, shift[0]) ^ crc2;
+}
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t plrH_crc32cPclmul(uint32_t crc, const unsigned char *buf, size_t len) {
+  for (; len != 0 && ((uintptr_t)buf & 7) != 0; --len) {
+    crc = _mm_crc32_u8(crc, *buf++);
+  }
+  for (; len >= 3*PLRH_CRC_LONG_BLOCK; len -= 3*PLRH_CRC_LONG_BLOCK, buf += 3*PLRH_CRC_LONG_BLOCK) {
+    crc = plrH_crc3Blocks(crc, buf, PLRH_CRC_LONG_BLOCK, g_crcShiftLong);
+  }
+  for (; len >= 3*PLRH_CRC_SHORT_BLOCK; len -= 3*PLRH_CRC_SHORT_BLOCK, buf += 3*PLRH_CRC_SHORT_BLOCK) {
+    crc = plrH_crc3Blocks(crc, buf, PLRH_CRC_SHORT_BLOCK, g_crcShiftShort);
+  }
+  return plrH_crc32cSse42(crc, buf, len);
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t plrH_mulFold64(uint64_t a, uint64_t b) {
+  unsigned __int128 prod = (unsigned __int128)a * b;
+  return (uint64_t)prod ^ (uint64_t)(prod >> 64);
+}
+
+static inline uint64_t plrH_avalanche(uint64_t h) {
+  h ^= h >> 37;
+  h *= 0x165667919e3779f9ULL;
+  h ^= h >> 32;
+  return h;
+}
+
+static inline uint64_t plrH_mix16(const unsigned char *in, const unsigned char *secret, uint64_t seed) {
+  return plrH_mulFold64(plrH_load64(in) ^ (plrH_load64(secret) + seed),
+                        plrH_load64(in + 8) ^ (plrH_load64(secret + 8) - seed));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint64_t plrH_xxh(uint64_t seed, unsigned char *dest, const unsigned char *buf, size_t len) {
+  const unsigned char *secret = g_xxhSecret;
+  uint64_t h = (len * PRIME64_1) ^ seed;
+  if (dest && len <= PLRH_XXH_MID_MAX) {
+    // Short enough to still be cached when it's hashed after copying
+    memcpy(dest, buf, len);
+  }
+  if (len <= 16) {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+    if (len >= 8) {
+      lo = plrH_load64(buf);
+      hi = plrH_load64(buf + len - 8);
+    } else if (len >= 4) {
+      lo = plrH_load32(buf);
+      hi = plrH_load32(buf + len - 4);
+    } else if (len > 0) {
+      lo = buf[0] | (buf[len/2] << 8) | (buf[len-1] << 16);
+    }
+    h += plrH_mulFold64(lo ^ (plrH_load64(secret) + seed), hi ^ (plrH_load64(secret + 8) - seed));
+  } else if (len <= PLRH_XXH_MID_MAX) {
+    // The products of the 16 byte pieces don't depend on each other
+    for (size_t i = 0; i + 16 < len; i += 16) {
+      h += plrH_mix16(buf + i, secret + i % (PLRH_XXH_SECRET_SIZE - 16), seed);
+    }
+    h += plrH_mix16(buf + len - 16, secret + PLRH_XXH_SECRET_SIZE - 16 - 3, seed);
+  } else {
+    uint64_t acc[8] __attribute__((aligned(32))) = {
+      PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+    };
+    g_xxhLong(acc, dest, buf, len);
+    for (int i = 0; i < 4; ++i) {
+      h += plrH_mulFold64(acc[2*i] ^ plrH_load64(secret + 11 + 16*i), acc[2*i+1] ^ plrH_load64(secret + 19 + 16*i));
+    }
+  }
+  return plrH_avalanche(h);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Runs the stripes of len (> PLRH_XXH_MID_MAX) bytes through acc, copying
+// each to dest unless it's NULL. Inlined into each implementation along
+// with its stripe & scramble functions, once copying & once not.
+__attribute__((always_inline))
+static inline void plrH_xxhLoop(uint64_t *accOut, unsigned char *dest, const unsigned char *buf, size_t len,
+                                xxhStripeFn_t stripe, xxhScrambleFn_t scramble) {
+  #define PLRH_DEST(offset) ((dest) ? (dest) + (offset) : NULL)
+  // Lanes in a local copy, which the compiler knows the stores to dest
+  // can't change, so they stay in registers
+  uint64_t acc[8] __attribute__((aligned(32)));
+  memcpy(acc, accOut, sizeof(acc));
+  const size_t blockLen = PLRH_XXH_STRIPE * PLRH_XXH_STRIPES_PER_BLOCK;
+  size_t nBlocks = (len - 1) / blockLen;
+  for (size_t b = 0; b < nBlocks; ++b) {
+    for (size_t n = 0; n < PLRH_XXH_STRIPES_PER_BLOCK; ++n) {
+      size_t offset = b*blockLen + n*PLRH_XXH_STRIPE;
+      stripe(acc, PLRH_DEST(offset), buf + offset, g_xxhSecret + n*8);
+    }
+    scramble(acc, g_xxhSecret + PLRH_XXH_SECRET_SIZE - PLRH_XXH_STRIPE);
+  }
+  // Stripes of the last, partial block, & the last stripe's worth of bytes,
+  // which overlaps the stripes before it
+  size_t nStripes = (len - 1 - nBlocks*blockLen) / PLRH_XXH_STRIPE;
+  for (size_t n = 0; n < nStripes; ++n) {
+    size_t offset = nBlocks*blockLen + n*PLRH_XXH_STRIPE;
+    stripe(acc, PLRH_DEST(offset), buf + offset, g_xxhSecret + n*8);
+  }
+  size_t offset = len - PLRH_XXH_STRIPE;
+  stripe(acc, PLRH_DEST(offset), buf + offset, g_xxhSecret + PLRH_XXH_SECRET_SIZE - PLRH_XXH_STRIPE - 7);
+  memcpy(accOut, acc, sizeof(acc));
+  #undef PLRH_DEST
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+__attribute__((always_inline))
+static inline void plrH_xxhStripeScalar(uint64_t *acc, unsigned char *dest, const unsigned char *in, const unsigned char *secret) {
+  for (int i = 0; i < 8; ++i) {
+    uint64_t data = plrH_load64(in + 8*i);
+    if (dest) {
+      plrH_store64(dest + 8*i, data);
+    }
+    uint64_t key = data ^ plrH_load64(secret + 8*i);
+    acc[i ^ 1] += data;
+    acc[i] += (key & 0xffffffff) * (key >> 32);
+  }
+}
+
+__attribute__((always_inline))
+static inline void plrH_xxhScrambleScalar(uint64_t *acc, const unsigned char *secret) {
+  for (int i = 0; i < 8; ++i) {
+    uint64_t a = acc[i];
+    a ^= a >> 47;
+    a ^= plrH_load64(secret + 8*i);
+    acc[i] = a * PRIME32_1;
+  }
+}
+
+static void plrH_xxhLongScalar(uint64_t *acc, unsigned char *dest, const unsigned char *buf, size_t len) {
+  if (dest) {
+    plrH_xxhLoop(acc, dest, buf, len, plrH_xxhStripeScalar, plrH_xxhScrambleScalar);
+  } else {
+    plrH_xxhLoop(acc, NULL, buf, len, plrH_xxhStripeScalar, plrH_xxhScrambleScalar);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(__x86_64__)
+
+// Same steps as the scalar version, 2 lanes per register. The data of the
+// neighbouring lane is added by swapping the 64-bit halves.
+__attribute__((always_inline))
+static inline void plrH_xxhStripeSse2(uint64_t *acc, unsigned char *dest, const unsigned char *in, const unsigned char *secret) {
+  __m128i *xacc = (__m128i*)acc;
+  for (int i = 0; i < 4; ++i) {
+    __m128i data = _mm_loadu_si128((const __m128i*)(in + 16*i));
+    if (dest) {
+      _mm_storeu_si128((__m128i*)(dest + 16*i), data);
+    }
+    __m128i key = _mm_xor_si128(data, _mm_loadu_si128((const __m128i*)(secret + 16*i)));
+    __m128i prod = _mm_mul_epu32(key, _mm_srli_epi64(key, 32));
+    __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+    xacc[i] = _mm_add_epi64(xacc[i], _mm_add_epi64(prod, swapped));
+  }
+}
+
+__attribute__((always_inline))
+static inline void plrH_xxhScrambleSse2(uint64_t *acc, const unsigned char *secret) {
+  __m128i *xacc = (__m128i*)acc;
+  const __m128i prime = _mm_set1_epi32(PRIME32_1);
+  for (int i = 0; i < 4; ++i) {
+    __m128i a = _mm_xor_si128(xacc[i], _mm_srli_epi64(xacc[i], 47));
+    a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i*)(secret + 16*i)));
+    __m128i lo = _mm_mul_epu32(a, prime);
+    __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+    xacc[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+  }
+}
+
+static void plrH_xxhLongSse2(uint64_t *acc, unsigned char *dest, const unsigned char *buf, size_t len) {
+  if (dest) {
+    plrH_xxhLoop(acc, dest, buf, len, plrH_xxhStripeSse2, plrH_xxhScrambleSse2);
+  } else {
+    plrH_xxhLoop(acc, NULL, buf, len, plrH_xxhStripeSse2, plrH_xxhScrambleSse2);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx2"), always_inline))
+static inline void plrH_xxhStripeAvx2(uint64_t *acc, unsigned char *dest, const unsigned char *in, const unsigned char *secret) {
+  __m256i *xacc = (__m256i*)acc;
+  for (int i = 0; i < 2; ++i) {
+    __m256i data = _mm256_loadu_si256((const __m256i*)(in + 32*i));
+    if (dest) {
+      _mm256_storeu_si256((__m256i*)(dest + 32*i), data);
+    }
+    __m256i key = _mm256_xor_si256(data, _mm256_loadu_si256((const __m256i*)(secret + 32*i)));
+    __m256i prod = _mm256_mul_epu32(key, _mm256_srli_epi64(key, 32));
+    __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+    xacc[i] = _mm256_add_epi64(xacc[i], _mm256_add_epi64(prod, swapped));
+  }
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline void plrH_xxhScrambleAvx2(uint64_t *acc, const unsigned char *secret) {
+  __m256i *xacc = (__m256i*)acc;
+  const __m256i prime = _mm256_set1_epi32(PRIME32_1);
+  for (int i = 0; i < 2; ++i) {
+    __m256i a = _mm256_xor_si256(xacc[i], _mm256_srli_epi64(xacc[i], 47));
+    a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i*)(secret + 32*i)));
+    __m256i lo = _mm256_mul_epu32(a, prime);
+    __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+    xacc[i] = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+  }
+}
+
+__attribute__((target("avx2")))
+static void plrH_xxhLongAvx2(uint64_t *acc, unsigned char *dest, const unsigned char *buf, size_t len) {
+  if (dest) {
+    plrH_xxhLoop(acc, dest, buf, len, plrH_xxhStripeAvx2, plrH_xxhScrambleAvx2);
+  } else {
+    plrH_xxhLoop(acc, NULL, buf, len, plrH_xxhStripeAvx2, plrH_xxhScrambleAvx2);
+  }
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef PLR_HASH_H
+#define PLR_HASH_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+// Digests of the data behind the arguments of checked calls, & of memory
+// compared between the redundant processes. Each class of data is hashed
+// with its own algorithm, and the implementation of each algorithm is
+// picked at load time from the instructions the CPU supports. All
+// implementations of an algorithm give the same digests, so processes &
+// call logs agree regardless of the CPU they ran on.
+
+typedef enum {
+  // Short strings, like paths, fopen modes & the names of printf variants
+  PLR_HASH_NAME,
+  // Output buffers of write calls
+  PLR_HASH_DATA,
+  // Program memory, checked by plr_check() & memory scrubbing
+  PLR_HASH_STATE,
+  PLR_HASH_NCLASSES
+} plrHashClass_t;
+
+typedef enum {
+  // CRC32C. SSE4.2 crc32 instructions over 3 interleaved streams, which
+  // are joined with PCLMUL, or table lookups 8 bytes at a time.
+  PLR_HASH_CRC32C,
+  // 64-bit multiply-accumulate hash in the style of XXH3, over 8 lanes
+  // kept in AVX2 or SSE2 registers
+  PLR_HASH_XXH,
+  PLR_HASH_NALGOS
+} plrHashAlgo_t;
+
+// Hashes len bytes at buf with algo, continuing from seed, the digest of
+// the data hashed before it (0 to start). The same sequence of buffers
+// gives the same digest.
+unsigned long plrH_hash(plrHashAlgo_t algo, unsigned long seed, const void *buf, size_t len);
+
+// Copies len bytes from src to dest & returns their digest like
+// plrH_hash(), in a single pass over the data. The buffers mustn't overlap.
+unsigned long plrH_copyHash(plrHashAlgo_t algo, unsigned long seed, void *dest, const void *src, size_t len);
+
+// Algorithm used for cls unless another one is selected
+plrHashAlgo_t plrH_defaultAlgo(plrHashClass_t cls);
+
+// Names of the classes & algorithms on the command line. The lookups
+// return -1 for an unknown name.
+const char *plrH_className(plrHashClass_t cls);
+const char *plrH_algoName(plrHashAlgo_t algo);
+int plrH_findClass(const char *name);
+int plrH_findAlgo(const char *name);
+
+// Name of the implementation of algo picked for this CPU
+const char *plrH_implName(plrHashAlgo_t algo);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,253 @@
+// _GNU_SOURCE for fallocate
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include "plrLog.h"
+#include "plrRecord.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Global variables & defines
+
+// Size of the window the log is written through, & the step it grows by
+#define PLR_RECORD_WINDOW_SIZE (1 << 20)
+
+// Window of the log currently mapped for writing
+static char *g_window = NULL;
+static unsigned long g_windowStart = 0;
+static unsigned long g_windowSize = 0;
+
+// Whole log, mapped for reading
+static const char *g_readMap = NULL;
+static unsigned long g_readEnd = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+// Private functions
+
+static int plrRec_mapWindow(const char *path, unsigned long start, unsigned long minSize);
+static int plrRec_mapRead(const char *path);
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plrRec_create(const char *path, const plrRecordHeader_t *header) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+  if (fd < 0) {
+    perror("open");
+    return -1;
+  }
+  int ret = 0;
+  if (write(fd, header, sizeof(*header)) != sizeof(*header)) {
+    perror("write");
+    ret = -1;
+  }
+  close(fd);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plrRec_readHeader(const char *path, plrRecordHeader_t *header) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    perror("open");
+    return -1;
+  }
+  int rdSize = read(fd, header, sizeof(*header));
+  close(fd);
+
+  if (rdSize != sizeof(*header) || memcmp(header->magic, PLR_RECORD_MAGIC, sizeof(header->magic)) != 0) {
+    plrlog(LOG_ERROR, "Error: %s is not a PLR call log\n", path);
+    return -1;
+  }
+  if (header->version != PLR_RECORD_VERSION) {
+    plrlog(LOG_ERROR, "Error: %s has log format version %d, expected %d\n", path, header->version, PLR_RECORD_VERSION);
+    return -1;
+  }
+  if (!header->finished) {
+    plrlog(LOG_ERROR, "Error: %s was never finished, the recorded run didn't exit normally\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plrRec_finish(const char *path, unsigned long nRecords, unsigned long dataEnd) {
+  int fd = open(path, O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    perror("open");
+    return -1;
+  }
+
+  int ret = 0;
+  plrRecordHeader_t header;
+  if (pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+    perror("pread");
+    ret = -1;
+  } else {
+    header.finished = 1;
+    header.nRecords = nRecords;
+    header.dataEnd = dataEnd;
+    if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+      perror("pwrite");
+      ret = -1;
+    } else if (ftruncate(fd, dataEnd) < 0) {
+      perror("ftruncate");
+      ret = -1;
+    }
+  }
+  close(fd);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plrRec_append(const char *path, unsigned long *end, const plrRecord_t *rec, const void *data) {
+  unsigned long start = *end;
+  unsigned long recEnd = plrRec_nextOffset(start, rec);
+  if (g_window == NULL || recEnd > g_windowStart + g_windowSize) {
+    if (plrRec_mapWindow(path, start, recEnd - start) < 0) {
+      return -1;
+    }
+  }
+
+  char *dest = g_window + (start - g_windowStart);
+  memcpy(dest, rec, sizeof(*rec));
+  memcpy(dest + sizeof(*rec), data, rec->dataLen);
+  *end = recEnd;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+const plrRecord_t *plrRec_read(const char *path, unsigned long offset) {
+  // Records appended after the log was mapped need a new mapping
+  if ((g_readMap == NULL || offset + sizeof(plrRecord_t) > g_readEnd) && plrRec_mapRead(path) < 0) {
+    return NULL;
+  }
+  if (offset + sizeof(plrRecord_t) > g_readEnd) {
+    return NULL;
+  }
+  const plrRecord_t *rec = (const plrRecord_t*)(g_readMap + offset);
+  if (plrRec_nextOffset(offset, rec) > g_readEnd) {
+    plrlog(LOG_ERROR, "[%d] Error: Record at %lu runs past the end of %s\n", getpid(), offset, path);
+    return NULL;
+  }
+  return rec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned long plrRec_nextOffset(unsigned long offset, const plrRecord_t *rec) {
+  return (offset + sizeof(*rec) + rec->dataLen + 7) & ~7UL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plrRec_discard(const char *path, unsigned long end) {
+  unsigned long pageSize = sysconf(_SC_PAGESIZE);
+  unsigned long start = (PLR_RECORD_FIRST_OFFSET + pageSize-1) & ~(pageSize-1);
+  end &= ~(pageSize-1);
+  if (end <= start) {
+    return 0;
+  }
+
+  int fd = open(path, O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    perror("open");
+    return -1;
+  }
+  int ret = 0;
+  if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, start, end - start) < 0) {
+    perror("fallocate");
+    ret = -1;
+  }
+  close(fd);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plrRec_mapWindow(const char *path, unsigned long start, unsigned long minSize) {
+  if (g_window != NULL && munmap(g_window, g_windowSize) < 0) {
+    perror("munmap");
+    return -1;
+  }
+  g_window = NULL;
+
+  // The window starts on the page holding start, & the log grows by whole
+  // windows. The space left after the last record is dropped by
+  // plrRec_finish.
+  unsigned long pageSize = sysconf(_SC_PAGESIZE);
+  g_windowStart = start & ~(pageSize-1);
+  g_windowSize = PLR_RECORD_WINDOW_SIZE;
+  while (g_windowSize < (start - g_windowStart) + minSize) {
+    g_windowSize *= 2;
+  }
+
+  // The fd is only open while mapping, so that the program sees the same
+  // fds as when it isn't recorded
+  int fd = open(path, O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    perror("open");
+    return -1;
+  }
+  // Only ever grow the log, another process may have mapped a window
+  // further into it
+  int ret = 0;
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    perror("fstat");
+    ret = -1;
+  } else if ((unsigned long)st.st_size < g_windowStart + g_windowSize
+             && ftruncate(fd, g_windowStart + g_windowSize) < 0) {
+    perror("ftruncate");
+    ret = -1;
+  } else {
+    g_window = mmap(NULL, g_windowSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, g_windowStart);
+    if (g_window == MAP_FAILED) {
+      perror("mmap");
+      g_window = NULL;
+      ret = -1;
+    }
+  }
+  close(fd);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plrRec_mapRead(const char *path) {
+  if (g_readMap != NULL && munmap((void*)g_readMap, g_readEnd) < 0) {
+    perror("munmap");
+    return -1;
+  }
+  g_readMap = NULL;
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    perror("open");
+    return -1;
+  }
+  int ret = 0;
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    perror("fstat");
+    ret = -1;
+  } else {
+    g_readMap = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (g_readMap == MAP_FAILED) {
+      perror("mmap");
+      g_readMap = NULL;
+      ret = -1;
+    } else {
+      g_readEnd = st.st_size;
+    }
+  }
+  close(fd);
+  return ret;
+}
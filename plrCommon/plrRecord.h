@@ -0,0 +1,81 @@
+#ifndef PLR_RECORD_H
+#define PLR_RECORD_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "plrCompare.h"
+#include "plrHash.h"
+
+// Call log of record & verify mode. The log is a header followed by one
+// record per checked syscall of the recorded process, each followed by the
+// results that its action passed on through plr_copyToShm. Records start
+// on an 8 byte boundary.
+
+#define PLR_RECORD_MAGIC "PLRLOG\0\0"
+// Version of the log format below, bumped whenever it changes
+#define PLR_RECORD_VERSION 3
+
+typedef struct {
+  char magic[8];
+  int version;
+  // getpid() value of the recorded run, returned again when verifying
+  int appPid;
+  // Settings that change which calls get a record, copied to the verify run
+  int epochLength;
+  long outputBatchLimit;
+  // Hash algorithm of each plrHashClass_t, which the recorded args depend on
+  int hashAlgo[PLR_HASH_NCLASSES];
+  // Boolean flag, set once the recorded run finished, along with the number
+  // of records & the end of the last one
+  int finished;
+  unsigned long nRecords;
+  unsigned long dataEnd;
+} plrRecordHeader_t;
+
+typedef struct {
+  // Arguments & deferred check hash of the call
+  syscallArgs_t args;
+  unsigned long deferredHash;
+  // Number of bytes of results that follow the record
+  unsigned long dataLen;
+} plrRecord_t;
+
+// Creates the log at path, or truncates it, and writes its header.
+// Returns 0 on success, -1 on failure.
+int plrRec_create(const char *path, const plrRecordHeader_t *header);
+
+// Reads & validates the header of the log at path.
+// Returns 0 on success, -1 on failure.
+int plrRec_readHeader(const char *path, plrRecordHeader_t *header);
+
+// Marks the log at path finished with nRecords records ending at dataEnd,
+// and drops the space reserved after it. Returns 0 on success, -1 on failure.
+int plrRec_finish(const char *path, unsigned long nRecords, unsigned long dataEnd);
+
+// Appends a record & dataLen bytes of results at *end of the log at path,
+// then advances *end. The log is written through a mapped window that
+// moves along as the log grows. Returns 0 on success, -1 on failure.
+int plrRec_append(const char *path, unsigned long *end, const plrRecord_t *rec, const void *data);
+
+// Returns the record at offset in the log at path, which is mapped whole on
+// the first call & mapped again for an offset past the end of that mapping,
+// or NULL if offset is past the last record. The results
+// follow the returned record, and the next one starts at
+// plrRec_nextOffset(offset, rec).
+const plrRecord_t *plrRec_read(const char *path, unsigned long offset);
+unsigned long plrRec_nextOffset(unsigned long offset, const plrRecord_t *rec);
+
+// Frees the space of the records before end in the log at path, which are
+// never read again. Offsets don't change, the space reads as zeros.
+// Returns 0 on success, -1 on failure.
+int plrRec_discard(const char *path, unsigned long end);
+
+// Offset of the first record, right after the header
+#define PLR_RECORD_FIRST_OFFSET ((sizeof(plrRecordHeader_t) + 7) & ~7UL)
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,345 @@
+// _GNU_SOURCE for MAP_ANONYMOUS
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include "plrLog.h"
+#include "futexUtil.h"
+#include "timeUtil.h"
+#include "plrRedundant.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Global data
+
+// Smallest argument & output area of a pool, larger calls grow it to the
+// next power of 2. Output slots are cache line aligned.
+#define PLR_REDUNDANT_MIN_CAP 4096
+#define PLR_REDUNDANT_SLOT_ALIGN 64
+// Interval at which the caller looks for dead workers while it waits
+#define PLR_REDUNDANT_REAP_MS 1
+
+typedef struct {
+  // Bumped by the caller to start a call, the workers sleep on it
+  int gen;
+  // Number of workers done with the current call, the caller sleeps on it
+  int done;
+  // Current call
+  plrRedundantFn_t fn;
+  size_t argLen;
+  size_t outLen;
+} redPoolCtl_t;
+
+typedef struct {
+  int pid;
+  // gen of the last call the worker finished
+  int doneGen;
+} redWorker_t;
+
+// The pool is a single shared mapping, inherited by the workers: the
+// control block, one redWorker_t per worker, the argument area and one
+// output slot per worker
+static redPoolCtl_t *g_ctl = NULL;
+static redWorker_t *g_workers = NULL;
+static char *g_argArea = NULL;
+static char *g_outArea = NULL;
+static size_t g_mapSize = 0;
+static size_t g_argCap = 0;
+static size_t g_outCap = 0;
+static int g_nProc = 0;
+static long g_timeoutMs = 0;
+// Process that set up the pool, the only one that may use or free it
+static int g_ownerPid = 0;
+// Whether workers are kept across calls, see plr_redundantSetReuse
+static int g_reuse = 0;
+// Set if the workers have to be forked before the next call, since there
+// are none or their copy of the caller's memory is out of date
+static int g_workersStale = 1;
+
+///////////////////////////////////////////////////////////////////////////////
+// Private functions
+
+static int plrRed_createPool(int nProc, long timeoutMs, size_t argCap, size_t outCap);
+static size_t plrRed_roundCap(size_t len);
+static char *plrRed_outSlot(int idx);
+static int plrRed_forkWorkers();
+static int plrRed_forkWorker(int idx);
+static int plrRed_reapDead(int gen);
+static void plrRed_workerLoop(int idx, int startGen) __attribute__((noreturn));
+static void plrRed_killWorker(int idx);
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_redundantInit(int nProc, long timeoutMs) {
+  if (nProc < 3) {
+    plrlog(LOG_ERROR, "Error: Function-level redundancy needs at least 3 processes to vote\n");
+    return -1;
+  } else if (timeoutMs < 1) {
+    plrlog(LOG_ERROR, "Error: Function-level redundancy timeout must be positive\n");
+    return -1;
+  }
+  return plrRed_createPool(nProc, timeoutMs, PLR_REDUNDANT_MIN_CAP, PLR_REDUNDANT_MIN_CAP);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_runRedundant(plrRedundantFn_t fn, const void *arg, size_t argLen, void *out, size_t outLen) {
+  if (g_ctl == NULL || g_ownerPid != getpid()) {
+    if (plrRed_createPool(PLR_REDUNDANT_DEFAULT_PROC, PLR_REDUNDANT_DEFAULT_TIMEOUT_MS,
+                          plrRed_roundCap(argLen), plrRed_roundCap(outLen)) < 0) {
+      return -1;
+    }
+  } else if (argLen > g_argCap || outLen > g_outCap) {
+    size_t argCap = (argLen > g_argCap) ? plrRed_roundCap(argLen) : g_argCap;
+    size_t outCap = (outLen > g_outCap) ? plrRed_roundCap(outLen) : g_outCap;
+    if (plrRed_createPool(g_nProc, g_timeoutMs, argCap, outCap) < 0) {
+      return -1;
+    }
+  }
+
+  if (g_workersStale && plrRed_forkWorkers() < 0) {
+    return -1;
+  }
+
+  // Publish the call, then wake the workers
+  memcpy(g_argArea, arg, argLen);
+  g_ctl->fn = fn;
+  g_ctl->argLen = argLen;
+  g_ctl->outLen = outLen;
+  g_ctl->done = 0;
+  int gen = __atomic_add_fetch(&g_ctl->gen, 1, __ATOMIC_SEQ_CST);
+  futex_wake(&g_ctl->gen, INT_MAX);
+
+  // Wait for all workers, or until the timeout for hung ones. Workers that
+  // died don't hold up the call, they're looked for every few ms.
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long long deadlineNs = tspecToNs(tspecAddMs(now, g_timeoutMs));
+  struct timespec reapInterval = tspecNewMs(PLR_REDUNDANT_REAP_MS);
+  int done;
+  while ((done = __atomic_load_n(&g_ctl->done, __ATOMIC_ACQUIRE)) < g_nProc
+         && done + plrRed_reapDead(gen) < g_nProc) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (tspecToNs(now) >= deadlineNs) {
+      break;
+    }
+    futex_wait(&g_ctl->done, done, &reapInterval);
+  }
+
+  // Find an output that a majority of the finished workers agrees on
+  int agreeIdx = -1;
+  for (int i = 0; i < g_nProc && agreeIdx < 0; ++i) {
+    if (__atomic_load_n(&g_workers[i].doneGen, __ATOMIC_ACQUIRE) != gen) {
+      continue;
+    }
+    int nAgree = 0;
+    for (int j = 0; j < g_nProc; ++j) {
+      if (__atomic_load_n(&g_workers[j].doneGen, __ATOMIC_ACQUIRE) == gen
+          && memcmp(plrRed_outSlot(i), plrRed_outSlot(j), outLen) == 0) {
+        ++nAgree;
+      }
+    }
+    if (nAgree > g_nProc/2) {
+      agreeIdx = i;
+    }
+  }
+  if (agreeIdx >= 0) {
+    memcpy(out, plrRed_outSlot(agreeIdx), outLen);
+  }
+
+  // Replace the workers that didn't finish or disagree with the majority.
+  // Without a majority, there's no telling which ones are faulted. Without
+  // reuse, all workers are stopped & forked again for the next call.
+  int ret = (agreeIdx >= 0) ? 0 : -1;
+  for (int i = 0; i < g_nProc; ++i) {
+    int finished = (__atomic_load_n(&g_workers[i].doneGen, __ATOMIC_ACQUIRE) == gen);
+    if (!g_reuse) {
+      plrRed_killWorker(i);
+    } else if (!finished || (agreeIdx >= 0 && memcmp(plrRed_outSlot(i), plrRed_outSlot(agreeIdx), outLen) != 0)) {
+      plrlog(LOG_DEBUG, "[%d] Replacing %s redundant worker %d\n", getpid(), finished ? "faulted" : "unfinished", g_workers[i].pid);
+      plrRed_killWorker(i);
+      if (plrRed_forkWorker(i) < 0) {
+        ret = -1;
+      }
+    }
+  }
+  g_workersStale = !g_reuse;
+  if (agreeIdx < 0) {
+    plrlog(LOG_ERROR, "[%d] Error: No majority of redundant workers agrees\n", getpid());
+  }
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void plr_redundantSetReuse(int reuse) {
+  g_reuse = reuse;
+  plr_redundantMemoryChanged();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void plr_redundantMemoryChanged() {
+  g_workersStale = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void plr_redundantExit() {
+  // Also called at exit of the program's own children, which mustn't touch
+  // the caller's workers
+  if (g_ctl == NULL || g_ownerPid != getpid()) {
+    return;
+  }
+  for (int i = 0; i < g_nProc; ++i) {
+    plrRed_killWorker(i);
+  }
+  if (munmap(g_ctl, g_mapSize) < 0) {
+    perror("munmap");
+  }
+  g_ctl = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plrRed_createPool(int nProc, long timeoutMs, size_t argCap, size_t outCap) {
+  static int atexitDone = 0;
+  if (!atexitDone) {
+    atexit(plr_redundantExit);
+    atexitDone = 1;
+  }
+  plr_redundantExit();
+
+  size_t headerSize = sizeof(redPoolCtl_t) + nProc*sizeof(redWorker_t);
+  headerSize = (headerSize + PLR_REDUNDANT_SLOT_ALIGN-1) & ~(size_t)(PLR_REDUNDANT_SLOT_ALIGN-1);
+  g_mapSize = headerSize + argCap + nProc*outCap;
+  void *map = mmap(NULL, g_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED) {
+    perror("mmap");
+    return -1;
+  }
+  g_ctl = map;
+  g_workers = (redWorker_t*)(g_ctl+1);
+  g_argArea = (char*)map + headerSize;
+  g_outArea = g_argArea + argCap;
+  g_argCap = argCap;
+  g_outCap = outCap;
+  g_nProc = nProc;
+  g_timeoutMs = timeoutMs;
+  g_ownerPid = getpid();
+  memset(g_workers, 0, nProc*sizeof(redWorker_t));
+
+  // Forked by the first call, with the caller's memory as it is then
+  g_workersStale = 1;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static size_t plrRed_roundCap(size_t len) {
+  size_t cap = PLR_REDUNDANT_MIN_CAP;
+  while (cap < len) {
+    cap *= 2;
+  }
+  return cap;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static char *plrRed_outSlot(int idx) {
+  return g_outArea + idx*g_outCap;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plrRed_forkWorkers() {
+  for (int i = 0; i < g_nProc; ++i) {
+    plrRed_killWorker(i);
+    if (plrRed_forkWorker(i) < 0) {
+      return -1;
+    }
+  }
+  g_workersStale = 0;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plrRed_forkWorker(int idx) {
+  // The worker only runs calls started after it was forked
+  int startGen = g_ctl->gen;
+  g_workers[idx].doneGen = startGen;
+  int callerPid = getpid();
+  int pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    g_workers[idx].pid = 0;
+    return -1;
+  } else if (pid == 0) {
+    // Die along with the caller
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != callerPid) {
+      _exit(1);
+    }
+    plrRed_workerLoop(idx, startGen);
+  }
+  g_workers[idx].pid = pid;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plrRed_workerLoop(int idx, int startGen) {
+  int seenGen = startGen;
+  while (1) {
+    int gen = __atomic_load_n(&g_ctl->gen, __ATOMIC_ACQUIRE);
+    if (gen == seenGen) {
+      futex_wait(&g_ctl->gen, gen, NULL);
+      continue;
+    }
+    seenGen = gen;
+
+    g_ctl->fn(g_argArea, plrRed_outSlot(idx));
+    __atomic_store_n(&g_workers[idx].doneGen, gen, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&g_ctl->done, 1, __ATOMIC_SEQ_CST);
+    futex_wake(&g_ctl->done, 1);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int plrRed_reapDead(int gen) {
+  // Workers that failed to fork count as dead too
+  int nDead = 0;
+  for (int i = 0; i < g_nProc; ++i) {
+    if (__atomic_load_n(&g_workers[i].doneGen, __ATOMIC_ACQUIRE) == gen) {
+      continue;
+    }
+    int pid = g_workers[i].pid;
+    if (pid > 0 && waitpid(pid, NULL, WNOHANG) == pid) {
+      plrlog(LOG_DEBUG, "[%d] Redundant worker %d died\n", getpid(), pid);
+      g_workers[i].pid = 0;
+    }
+    if (g_workers[i].pid <= 0) {
+      ++nDead;
+    }
+  }
+  return nDead;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void plrRed_killWorker(int idx) {
+  int pid = g_workers[idx].pid;
+  if (pid > 0) {
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+  }
+  g_workers[idx].pid = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef PLR_REDUNDANT_H
+#define PLR_REDUNDANT_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+// Function-level redundancy, for programs that only need a single hot
+// function protected instead of running under plr as a whole. The function
+// runs in worker processes forked from the caller, and the output a
+// majority of them agrees on is returned. Workers that disagree, die or
+// hang past the timeout are voted out & replaced by a new fork of the
+// caller.
+//
+// By default the workers are forked for every call, so the function sees
+// the caller's memory as it is at the call. Only the shared memory of the
+// pool is kept across calls. Callers making many calls can keep the
+// workers as well with plr_redundantSetReuse. Not for use in programs run
+// under plr, or from more than one thread at a time.
+
+// Number of workers & timeout of a pool set up on first use
+#define PLR_REDUNDANT_DEFAULT_PROC 3
+#define PLR_REDUNDANT_DEFAULT_TIMEOUT_MS 1000
+
+// Function run by the workers. Writes its result to out, which has the
+// outLen bytes passed to plr_runRedundant.
+typedef void (*plrRedundantFn_t)(const void *arg, void *out);
+
+// Sets up the worker pool with nProc (at least 3) workers, which are given
+// timeoutMs to finish each call. Tears down an existing pool first.
+// Optional, plr_runRedundant sets up a default pool on first use.
+// Returns 0 on success, -1 on failure.
+int plr_redundantInit(int nProc, long timeoutMs);
+
+// Runs fn(arg, out) in every worker & copies the output that a majority of
+// them agrees on to out. argLen bytes at arg are copied to the workers.
+// Returns 0 on success, or -1 if no majority agreed or on an error, in
+// which case out is left unchanged.
+int plr_runRedundant(plrRedundantFn_t fn, const void *arg, size_t argLen, void *out, size_t outLen);
+
+// With reuse set, the workers are kept across calls, which saves forking
+// them. Their copy of the caller's memory is then only as recent as the
+// fork, so the caller must call plr_redundantMemoryChanged after writing
+// any memory the function reads, other than the arg passed to it.
+void plr_redundantSetReuse(int reuse);
+
+// Makes the next call fork the workers again, with the caller's memory as
+// it is then.
+void plr_redundantMemoryChanged();
+
+// Stops the workers & frees the pool. Also run at exit.
+void plr_redundantExit();
+
+#ifdef __cplusplus
+}
+#endif
+#endif
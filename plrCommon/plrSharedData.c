@@ -51,7 +51,10 @@ int plrSD_initSharedData(int nProc) {
   
   // Initialize values in plrShm. Values not explicitly initalized here default
   // to zero because of ftruncate on shmFd.
+  plrShm->layoutVersion = PLR_SHM_LAYOUT_VERSION;
   plrShm->nProc = nProc;
+  plrShm->maxProc = nProc;
+  plrShm->barrierActionIdx = -1;
   pthread_mutex_init_pshared(&plrShm->lock);
   pthread_mutex_init_pshared(&plrShm->toolLock);
   
@@ -71,9 +74,17 @@ int plrSD_acquireSharedData() {
     return -1;
   }
   
+  // Refuse to use a data area laid out by a different build of PLR
+  if (plrShm->layoutVersion != PLR_SHM_LAYOUT_VERSION) {
+    plrlog(LOG_ERROR, "Error: PLR shared data layout version %d, expected %d\n",
+      plrShm->layoutVersion, PLR_SHM_LAYOUT_VERSION);
+    munmap(plrShm, sizeof(plrData_t));
+    return -1;
+  }
+  
   // Then remap to get the per-process data areas too
   // Can't use mremap because Pin doesn't seem to support it
-  int shmSize = sizeof(plrData_t) + plrShm->nProc*sizeof(perProcData_t);
+  int shmSize = sizeof(plrData_t) + plrShm->maxProc*sizeof(perProcData_t);
   if (munmap(plrShm, sizeof(plrData_t)) < 0) {
     perror("munmap");
     return -1;
@@ -131,7 +142,12 @@ int plrSD_initProcDataAsCopy(perProcData_t *procShm, perProcData_t *src) {
   
   // Copy stored syscall arguments & other state from parent
   procShm->shmFd = src->shmFd;
-  memcpy(&procShm->syscallArgs, &src->syscallArgs, sizeof(syscallArgs_t));
+  memcpy(procShm->syscallArgs, src->syscallArgs, sizeof(procShm->syscallArgs));
+  memcpy(procShm->deferredHash, src->deferredHash, sizeof(procShm->deferredHash));
+  
+  // New process hasn't arrived at the current tree barrier yet, even if the
+  // parent has
+  procShm->treeArriveGen = __atomic_load_n(&plrShm->barrierGen, __ATOMIC_ACQUIRE);
   
   return 0;
 }
@@ -176,7 +192,7 @@ static int plrSD_extraShmOffset() {
   if (extraShmOffset == 0) {
     // Determine offset of extra shm area within shm file, must be page aligned
     int pageSize = sysconf(_SC_PAGE_SIZE);
-    int fixedDataSize = sizeof(plrData_t) + plrShm->nProc*sizeof(perProcData_t);
+    int fixedDataSize = sizeof(plrData_t) + plrShm->maxProc*sizeof(perProcData_t);
     int rem = fixedDataSize % pageSize;
     extraShmOffset = (rem == 0) ? fixedDataSize : fixedDataSize + pageSize - rem;
   }
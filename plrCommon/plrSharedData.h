@@ -5,58 +5,303 @@ extern "C" {
 #endif
 
 #include <pthread.h>
+#include <limits.h>
 #include "plrCompare.h"
+#include "plrHash.h"
 
+// Version of the shared memory layout below. Must be bumped whenever
+// perProcData_t or plrData_t change, so that processes built against
+// different layouts refuse to share a data area instead of corrupting it.
+#define PLR_SHM_LAYOUT_VERSION 17
+
+// Fields written by different processes are kept on separate cache lines,
+// so that e.g. a process updating its own slot doesn't invalidate the line
+// another process is polling at a barrier.
+#define PLR_CACHE_LINE_SIZE 64
+#define PLR_CACHE_ALIGNED __attribute__((aligned(PLR_CACHE_LINE_SIZE)))
+
+// Adaptive watchdog statistics are kept for this many call types, keyed by
+// the addr of the syscallArgs_t last checked before a barrier. Entry 0 is
+// for barriers before any checked call & call types that don't fit.
+#define PLR_WATCHDOG_CALL_TYPES 32
+// Arrival skew histogram buckets, bucket i counts skews of [2^i, 2^(i+1))
+// microseconds (bucket 0 also counts anything shorter)
+#define PLR_WATCHDOG_SKEW_BUCKETS 24
+
+typedef struct {
+  // Call type key, syscallArgs_t addr (NULL for entry 0 & unused entries)
+  void *addr;
+  // Number of skew samples in skewHist
+  unsigned int samples;
+  unsigned int skewHist[PLR_WATCHDOG_SKEW_BUCKETS];
+  // Current adaptive timeout of this call type in milliseconds, 0 until
+  // enough samples were taken to learn it
+  long timeoutMs;
+} watchdogStats_t;
+
+// Maximum number of entries slaves may lag behind the master in
+// asynchronous mode, i.e. the size of the entry ring
+#define PLR_ASYNC_MAX_LAG 64
+
+// Entry of the asynchronous mode ring, one per checked syscall of the master
+typedef struct {
+  // Arguments & deferred check hash of the master, checked by each slave
+  syscallArgs_t args;
+  unsigned long deferredHash;
+  // Results of the action, as written by plr_copyToShm, are stored in
+  // extraShm at dataOffset
+  int dataOffset;
+  int dataLen;
+  // Set by plr_waitForSlavesAfterAction, the master doesn't publish the
+  // next entry until every slave is done with this one
+  int drain;
+} asyncEntry_t;
+
+// Maximum number of checkpoints kept, & the size of their ring, which also
+// holds the one taken last until it counts
+#define PLR_CKPT_MAX_RETAIN 16
+#define PLR_CKPT_RING_SIZE (PLR_CKPT_MAX_RETAIN+1)
+
+// Checkpoint, a frozen copy of the master taken at the start of a checked
+// syscall, parked until the group is rolled back to it
 typedef struct {
   int pid;
-  // File descriptor of shared memory area
-  int shmFd;
+  // Futex word the checkpoint sleeps on, set to 1 to resume it
+  int wake;
+  // Offset of the call log record of the checked syscall it was taken at
+  unsigned long logOffset;
+} ckptEntry_t;
+
+// Each process's slot starts on its own cache line. Within it, fields are
+// grouped by who writes them: other processes (barrier release & wakeups),
+// this process on every syscall, and rarely written state.
+typedef struct {
+  // Barrier state, also written by the process releasing the barrier or
+  // waking this process up
   // Index of condition variable currently waiting in. Value of -1 indicates
   // not waiting, whereas 0 or 1 gives the index currently waiting in.
   int waitIdx;
+  // Futex word this process sleeps on in the futex barrier. Incremented by
+  // whichever process wants to wake this one up.
+  int futexWord;
+  // Boolean flag, set while this process is parked in futex_wait on
+  // futexWord. Wakers skip the futex_wake syscall when it isn't set.
+  int futexParked;
+  // Boolean flag, set by the figurehead when this process died while still
+  // part of the group, so it can be replaced without waiting for the watchdog
+  int died;
+  
   // Two separate condition variables used to keep track of separate wait events.
-  pthread_cond_t cond[2];
-  // Saved syscall arguments from last checked syscall
-  syscallArgs_t syscallArgs;
+  pthread_cond_t cond[2] PLR_CACHE_ALIGNED;
+  
+  // Written by this process on every checked syscall, read by the voters
+  // Saved syscall arguments from last checked syscall, double buffered by
+  // the index of the barrier they were checked at (curWaitIdx)
+  syscallArgs_t syscallArgs[2] PLR_CACHE_ALIGNED;
+  // Hash of syscall argument checks deferred since the last checked syscall,
+  // compared along with syscallArgs and buffered the same way
+  unsigned long deferredHash[2];
+  // Asynchronous mode progress of a slave. asyncSeq counts the ring entries
+  // this process is done with (including reading their results), and
+  // asyncVerified the entries whose arguments it found matching. When the
+  // arguments of an entry disagree, asyncDiverged is set to its index+1 &
+  // this process's arguments are published in syscallArgs[0].
+  unsigned long asyncSeq;
+  unsigned long asyncVerified;
+  unsigned long asyncDiverged;
+  // Boolean flag, set while this process waits for another one to make
+  // progress in asynchronous mode. Processes that make progress only wake
+  // those with it set.
+  int asyncWaiting;
+  
+  // Written by this process only
+  // Boolean flag, indicates that currently inside PLR code
+  int insidePLR PLR_CACHE_ALIGNED;
   // Current mapped size of extra shared memory area for this process
   int extraShmMapped;
-  // Boolean flag, indicates that currently inside PLR code
-  int insidePLR;
-} perProcData_t;
+  // Boolean flag, set once this process has voted itself faulted and left
+  // all barriers, so it's safe for a good process to replace it
+  int awaitingRepair;
+  // Tree barrier arrival, set to barrierGen+1 once this process and all of
+  // its tree children have arrived at the current barrier. Polled by the
+  // tree parent of this process.
+  unsigned int treeArriveGen;
+  int pid;
+  // File descriptor of shared memory area
+  int shmFd;
+  // Verify mode progress, number of log records this process checked, &
+  // the index+1 of the record it disagreed with (0 if none)
+  unsigned long verifyRecords;
+  unsigned long verifyDiverged;
+} PLR_CACHE_ALIGNED perProcData_t;
 
 typedef struct {
+  // Rarely written configuration & state. layoutVersion must stay the first
+  // field of every layout version.
+  // Layout of this data area, PLR_SHM_LAYOUT_VERSION of the creator
+  int layoutVersion;
   // Figurehead process PID
   int figureheadPid;
-  // Total number of redundant processes
+  // PID returned by getpid() to the program. The figurehead's PID, except
+  // when verifying a log, where it's the PID of the recorded run.
+  int appPid;
+  // Number of redundant processes currently in the group, which use the
+  // first nProc slots of allProcShm. Only changes with adaptive redundancy.
   int nProc;
-  // Watchdog timeout interval (in milliseconds)
+  // Number of slots in allProcShm
+  int maxProc;
+  // Watchdog timeout interval (in milliseconds). Upper bound of the timeout
+  // when the adaptive watchdog is enabled.
   long watchdogTimeout;
-  // Index of current condition variable to wait in.
-  int curWaitIdx;
-  // Count of processes currently waiting for a given condition
-  // variable index.
-  int condWaitCnt[2];
-  // Boolean flag, set true when in the middle of restoring a failed process.
-  int restoring;
-  // Mutex lock used for shared across all PLR processes.
-  pthread_mutex_t lock;
+  // Adaptive watchdog configuration, disabled while watchdogPercentile is 0.
+  // The timeout of each call type is watchdogMultiple times this percentile
+  // of its arrival skew, but at least watchdogMinTimeout (in milliseconds).
+  int watchdogPercentile;
+  int watchdogMultiple;
+  long watchdogMinTimeout;
+  // Time to busy-poll at a barrier before sleeping (in microseconds),
+  // 0 to always sleep right away. Never more than the watchdog timeout.
+  long spinBudgetUs;
+  // Barrier implementation used by plr_waitBarrier (a plrBarrierMode_t)
+  int barrierMode;
+  // Boolean flag, lets a majority of processes leave checked action
+  // barriers without waiting for the rest (futex barrier only)
+  int quorum;
+  // Asynchronous mode, number of ring entries the slaves may lag behind
+  // the master. 0 for the default synchronous mode.
+  int asyncLag;
+  // Number of calls checked with plr_foldSyscallArgs that are folded into
+  // a hash before the processes compare it. 0 to compare every call.
+  int epochLength;
+  // Adaptive redundancy, disabled while adaptCleanMs is 0. The group drops
+  // to PLR_ADAPT_MIN_PROC processes once adaptHoldMs passed without a fault,
+  // & goes back up to maxProc after a fault. adaptHoldMs starts out at
+  // adaptCleanMs, doubles with every fault & halves with every drop.
+  // adaptLastEventNs is the CLOCK_MONOTONIC time of the last fault or drop,
+  // and adaptGrow is set by a fault until the group grew.
+  long adaptCleanMs;
+  long adaptHoldMs;
+  unsigned long long adaptLastEventNs;
+  int adaptGrow;
+  // Record & verify mode (a plrLogMode_t), and the path of the call log,
+  // which is also where checkpointing logs the calls to replay
+  int logMode;
+  char logPath[PATH_MAX];
+  // Checkpointing, disabled while ckptIntervalMs is 0. Once ckptIntervalMs
+  // passed since ckptLastNs (the CLOCK_MONOTONIC time of the last
+  // checkpoint), the barrier action sets ckptAtCall to the number of the
+  // next checked syscall, counted from 1 in every process, & the master
+  // takes a checkpoint at its start. 0 while none is due. ckptRetain are
+  // kept, not counting the one taken last.
+  long ckptIntervalMs;
+  int ckptRetain;
+  unsigned long long ckptLastNs;
+  unsigned long ckptAtCall;
+  // Boolean flag, set from when the group is killed for a rollback until
+  // the checkpoint took over slot 0, & the end of the calls it replays
+  int ckptRollback;
+  unsigned long ckptReplayEnd;
+  // Live checkpoints n, ckptTail <= n < ckptHead, kept at
+  // ckpts[n % PLR_CKPT_RING_SIZE]. Dropping the oldest advances ckptTail,
+  // & a rollback resumes the newest & takes ckptHead back.
+  unsigned long ckptHead;
+  unsigned long ckptTail;
+  ckptEntry_t ckpts[PLR_CKPT_RING_SIZE];
+  // Output batching, bytes queued per fd before the replicas check & write
+  // them out. 0 to check & write every output call right away.
+  long outputBatchLimit;
+  // Percentage of the run time that plr_check() of the program may spend
+  // hashing, see plrApi.h. 100 checks every call.
+  int checkBudgetPct;
+  // Memory scrubbing, checked syscalls between scrubs. 0 when disabled.
+  int scrubInterval;
+  // Algorithm each plrHashClass_t is hashed with
+  int hashAlgo[PLR_HASH_NCLASSES];
   // Current global size of extra shared memory area
   int extraShmSize;
   // Boolean flag, indicates that "insidePLR" flag should start out set
   int insidePLRInitTrue;
   // Boolean flag, indicates that process init has run once
   int didProcessInit;
+  // Boolean flag, set true when in the middle of restoring a failed process.
+  int restoring;
+  // Boolean flag, set when the processes detected a fault they can't
+  // correct & the group was aborted
+  int faultDetected;
+  
+  // Barrier arrival counters, atomically incremented by every process
+  // Count of processes currently waiting for a given condition
+  // variable index.
+  int condWaitCnt[2] PLR_CACHE_ALIGNED;
+  // Quorum mode arrivals per barrier index, one bit per allProcShm index.
+  // PLR_QUORUM_CLOSED is set when a majority left without the processes
+  // that aren't set, and stays set until the late process catches up.
+  unsigned int quorumArriveMask[2];
+  // Time the watchdog of the barrier at each index was armed, by the first
+  // process to arrive & not moved by later arrivals. The deadline is a
+  // watchdog timeout later. Stored as (CLOCK_MONOTONIC ns << 2) |
+  // (barrierGen & 3), so that a time left over from an earlier generation
+  // isn't taken for the current one.
+  unsigned long long watchdogArmed[2];
+  
+  // Barrier release state, written once per barrier & polled by waiters
+  // Index of current condition variable to wait in.
+  int curWaitIdx PLR_CACHE_ALIGNED;
+  // Futex barrier state. barrierGen is incremented each time a barrier
+  // completes, and barrierClaimGen is advanced by the one process that
+  // claims completion of the current generation.
+  unsigned int barrierGen;
+  unsigned int barrierClaimGen;
+  // Index in allProcShm of the process that has been handed the futex
+  // barrier action to run, or -1 if none.
+  int barrierActionIdx;
+  // Boolean flag per barrier index, set by the barrier action of the checked
+  // action functions when the arguments disagree and the action wasn't run
+  int checkedActionFault[2];
+  // Adaptive redundancy decision per barrier index, set by the barrier
+  // action of the checked action functions. The number of processes the
+  // group is resized to right after the barrier, or 0 to keep it.
+  int adaptResizeTo[2];
+  
+  // Asynchronous mode ring, written by the master & read by the slaves.
+  // asyncHead is the number of entries published, entry n is kept at
+  // asyncRing[n % asyncLag]. asyncDataEnd is where the results of the next
+  // entry go in extraShm, reset to 0 whenever the slaves caught up.
+  unsigned long asyncHead PLR_CACHE_ALIGNED;
+  int asyncDataEnd;
+  asyncEntry_t asyncRing[PLR_ASYNC_MAX_LAG];
+  
+  // Record mode progress, written by the recording process, or by the
+  // executors when checkpointing. Number of records in the log & end of
+  // the last one.
+  unsigned long logRecords PLR_CACHE_ALIGNED;
+  unsigned long logEnd;
+  
+  // Mutex lock used for shared across all PLR processes.
+  pthread_mutex_t lock PLR_CACHE_ALIGNED;
+  
+  // Barrier statistics, atomically incremented by every process. Number of
+  // times a process woke up while waiting at a barrier, and how many of
+  // those found nothing to do & went back to sleep.
+  unsigned long barrierWakeups PLR_CACHE_ALIGNED;
+  unsigned long spuriousWakeups;
+  
+  // Adaptive watchdog statistics, updated by the last process to arrive at
+  // each barrier
+  watchdogStats_t watchdogStats[PLR_WATCHDOG_CALL_TYPES] PLR_CACHE_ALIGNED;
   
   // Fault injection pintool data
   // The following data is added here for convenience, to avoid creating a separate shared 
   // data region. It is only used by the fault injection pintool, not by PLR itself.
-  pthread_mutex_t toolLock;
+  // eventCount is written on every instrumented event, so this is kept away
+  // from all of the barrier state above.
+  pthread_mutex_t toolLock PLR_CACHE_ALIGNED;
   int faultInjected;
   int nextFaultIdx;
   int nextFaultPid;
   unsigned long eventCount;
   unsigned long targetCount;
-} plrData_t;
+} PLR_CACHE_ALIGNED plrData_t;
 
 extern plrData_t *plrShm;
 // allProcShm is an array of all processes' per-proc data, 
@@ -26,6 +26,10 @@ int pthread_cond_init_pshared(pthread_cond_t *cond) {
     fprintf(stderr, "pthread_condattr_setpshared failed with code %d\n", ret);
     return ret;
   }
+  if ((ret = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC)) != 0) {
+    fprintf(stderr, "pthread_condattr_setclock failed with code %d\n", ret);
+    return ret;
+  }
   if ((ret = pthread_cond_init(cond, &attr)) != 0) {
     fprintf(stderr, "pthread_condattr_init failed with code %d\n", ret);
     return ret;
@@ -9,7 +9,9 @@ extern "C" {
 // Initializes a pthread_mutex_t with the PTHREAD_PROCESS_SHARED attribute set
 int pthread_mutex_init_pshared(pthread_mutex_t *mutex);
 
-// Initializes a pthread_cond_t with the PTHREAD_PROCESS_SHARED attribute set
+// Initializes a pthread_cond_t with the PTHREAD_PROCESS_SHARED attribute set.
+// Timed waits on it take CLOCK_MONOTONIC deadlines, so they aren't affected
+// by changes to the system time.
 int pthread_cond_init_pshared(pthread_cond_t *cond);
 
 #ifdef __cplusplus
@@ -52,3 +52,12 @@ struct timespec tspecSub(const struct timespec tspec1, const struct timespec tsp
 double tspecToFloat(const struct timespec tspec) {
   return (double)tspec.tv_sec + (tspec.tv_nsec / 1000000000.0);
 }
+
+long long tspecToNs(const struct timespec tspec) {
+  return (long long)tspec.tv_sec*1000000000 + tspec.tv_nsec;
+}
+
+struct timespec tspecFromNs(long long nsec) {
+  struct timespec tspec = { .tv_sec = nsec / 1000000000, .tv_nsec = nsec % 1000000000 };
+  return tspec;
+}
@@ -13,6 +13,10 @@ struct timespec tspecAddMs(const struct timespec tspec, long int msec);
 // Note that tspecSub will return a negative timespec if tspec2 > tspec1
 struct timespec tspecSub(const struct timespec tspec1, const struct timespec tspec2);
 double tspecToFloat(const struct timespec tspec);
+// Conversion to & from a single nanosecond count, e.g. to store a timespec
+// where it must be read & written atomically
+long long tspecToNs(const struct timespec tspec);
+struct timespec tspecFromNs(long long nsec);
 
 #ifdef __cplusplus
 }
@@ -7,6 +7,10 @@
 #include <errno.h>
 #include <string.h>
 #include <limits.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
 #include "plr.h"
 #include "plrLog.h"
 
@@ -21,6 +25,30 @@ typedef enum {
 
 static PINTOOL_MODE g_pintoolMode = PINTOOL_MODE_OFF;
 static int g_numRedunProc = 3;
+static plrBarrierMode_t g_barrierMode = PLR_BARRIER_COND;
+static int g_barrierModeSet = 0;
+static long g_spinBudgetUs = 0;
+static int g_quorum = 0;
+static int g_asyncLag = 0;
+static long g_outputBatchLimit = 0;
+static int g_checkBudgetPct = PLR_CHECK_DEFAULT_BUDGET;
+static int g_scrubInterval = 0;
+// Hash algorithm selected with -H for each plrHashClass_t, -1 for the default
+static int g_hashAlgo[PLR_HASH_NCLASSES] = { [0 ... PLR_HASH_NCLASSES-1] = -1 };
+static int g_epochLength = 0;
+static int g_watchdogPercentile = 0;
+static int g_watchdogMultiple = 4;
+static long g_watchdogMinMs = 10;
+static char *g_watchdogStatsFile = NULL;
+static long g_adaptCleanMs = 0;
+static long g_ckptIntervalMs = 0;
+static int g_ckptRetain = 0;
+static char *g_recordLogFile = NULL;
+static char *g_verifyLogFile = NULL;
+// Signals handled by the figurehead event loop, blocked from before the
+// first process is started, and the original mask restored for it
+static sigset_t g_superviseSigMask;
+static sigset_t g_origSigMask;
 long g_injectEventMean = 0;
 char *g_injectEventMeanStr = NULL;
 
@@ -29,6 +57,9 @@ char *g_injectEventMeanStr = NULL;
 
 void atexit_cleanupShm();
 int startFirstProcess(int argc, char **argv);
+int superviseProcesses(long watchdogTimeout);
+int reapChildren();
+void watchProcesses(struct pollfd *pidFds, int *watchedPids);
 void printUsage();
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -40,7 +71,7 @@ int main(int argc, char *argv[]) {
   
   // Parse command line arguments
   int opt;
-  while ((opt = getopt(argc, argv, "hp:m:n:t:o:e:")) != -1) {
+  while ((opt = getopt(argc, argv, "hp:m:n:t:o:e:b:s:qA:B:E:K:S:H:r:c:C:a:k:l:W:R:V:")) != -1) {
     switch (opt) {
     case 'h':
       printUsage();
@@ -83,6 +114,157 @@ int main(int argc, char *argv[]) {
       }
       watchdogTimeout = val;
     } break;
+    case 'b':
+      if (strcmp(optarg, "cond") == 0) {
+        g_barrierMode = PLR_BARRIER_COND;
+      } else if (strcmp(optarg, "futex") == 0) {
+        g_barrierMode = PLR_BARRIER_FUTEX;
+      } else if (strcmp(optarg, "tree") == 0) {
+        g_barrierMode = PLR_BARRIER_TREE;
+      } else {
+        fprintf(stderr, "Error: Invalid barrier mode for -b, must be \"cond\", \"futex\" or \"tree\"\n");
+        return 1;
+      }
+      g_barrierModeSet = 1;
+      break;
+    case 's': {
+      char *endptr;
+      long val = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || ((val == LONG_MIN || val == LONG_MAX) && errno == ERANGE)) {
+        fprintf(stderr, "Error: Argument for -s is not an integer value\n");
+        return 1;
+      }
+      g_spinBudgetUs = val;
+    } break;
+    case 'q':
+      g_quorum = 1;
+      break;
+    case 'A': {
+      char *endptr;
+      long val = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || val < 1 || val > INT_MAX) {
+        fprintf(stderr, "Error: Argument for -A must be a positive integer\n");
+        return 1;
+      }
+      g_asyncLag = val;
+    } break;
+    case 'B': {
+      char *endptr;
+      errno = 0;
+      long val = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || (val == LONG_MAX && errno == ERANGE) || val < 1) {
+        fprintf(stderr, "Error: Argument for -B must be a positive integer\n");
+        return 1;
+      }
+      g_outputBatchLimit = val;
+    } break;
+    case 'E': {
+      char *endptr;
+      long val = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || val < 1 || val > INT_MAX) {
+        fprintf(stderr, "Error: Argument for -E must be a positive integer\n");
+        return 1;
+      }
+      g_epochLength = val;
+    } break;
+    case 'K': {
+      char *endptr;
+      long val = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || val < 1 || val > 100) {
+        fprintf(stderr, "Error: Argument for -K must be a percentage between 1 and 100\n");
+        return 1;
+      }
+      g_checkBudgetPct = val;
+    } break;
+    case 'S': {
+      char *endptr;
+      long val = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || val < 1 || val > INT_MAX) {
+        fprintf(stderr, "Error: Argument for -S must be a positive integer\n");
+        return 1;
+      }
+      g_scrubInterval = val;
+    } break;
+    case 'H': {
+      char *eq = strchr(optarg, '=');
+      int cls = -1;
+      int algo = -1;
+      if (eq != NULL) {
+        *eq = '\0';
+        cls = plrH_findClass(optarg);
+        algo = plrH_findAlgo(eq+1);
+      }
+      if (cls < 0 || algo < 0) {
+        fprintf(stderr, "Error: Argument for -H must be <class>=<algorithm>, with class \"name\", \"data\" or \"state\" & algorithm \"crc32c\" or \"xxh\"\n");
+        return 1;
+      }
+      g_hashAlgo[cls] = algo;
+    } break;
+    case 'r': {
+      char *endptr;
+      errno = 0;
+      long val = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || (val == LONG_MAX && errno == ERANGE) || val < 1) {
+        fprintf(stderr, "Error: Argument for -r must be a positive integer\n");
+        return 1;
+      }
+      g_adaptCleanMs = val;
+    } break;
+    case 'c': {
+      char *endptr;
+      errno = 0;
+      long val = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || (val == LONG_MAX && errno == ERANGE) || val < 1) {
+        fprintf(stderr, "Error: Argument for -c must be a positive integer\n");
+        return 1;
+      }
+      g_ckptIntervalMs = val;
+    } break;
+    case 'C': {
+      char *endptr;
+      long val = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || val < 1 || val > INT_MAX) {
+        fprintf(stderr, "Error: Argument for -C must be a positive integer\n");
+        return 1;
+      }
+      g_ckptRetain = val;
+    } break;
+    case 'a': {
+      char *endptr;
+      long val = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || val < 1 || val > 100) {
+        fprintf(stderr, "Error: Argument for -a must be a percentile between 1 and 100\n");
+        return 1;
+      }
+      g_watchdogPercentile = val;
+    } break;
+    case 'k': {
+      char *endptr;
+      long val = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || val < 1 || val > INT_MAX) {
+        fprintf(stderr, "Error: Argument for -k must be a positive integer\n");
+        return 1;
+      }
+      g_watchdogMultiple = val;
+    } break;
+    case 'l': {
+      char *endptr;
+      long val = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || ((val == LONG_MIN || val == LONG_MAX) && errno == ERANGE)) {
+        fprintf(stderr, "Error: Argument for -l is not an integer value\n");
+        return 1;
+      }
+      g_watchdogMinMs = val;
+    } break;
+    case 'W':
+      g_watchdogStatsFile = optarg;
+      break;
+    case 'R':
+      g_recordLogFile = optarg;
+      break;
+    case 'V':
+      g_verifyLogFile = optarg;
+      break;
     case 'o':
       outputFile = optarg;
       break;
@@ -107,6 +289,23 @@ int main(int argc, char *argv[]) {
   }
   char **progArgv = &argv[optind];
   
+  if (g_recordLogFile != NULL && g_verifyLogFile != NULL) {
+    fprintf(stderr, "Error: Options -R and -V can't be combined\n");
+    return 1;
+  }
+  if (g_ckptRetain > 0 && g_ckptIntervalMs == 0) {
+    fprintf(stderr, "Error: Option -C requires -c\n");
+    return 1;
+  }
+  if (g_watchdogStatsFile != NULL && g_watchdogPercentile == 0) {
+    fprintf(stderr, "Error: Option -W requires -a\n");
+    return 1;
+  }
+  // The recorded run is a single process, the verify run checks it
+  if (g_recordLogFile != NULL) {
+    g_numRedunProc = 1;
+  }
+  
   if (getenv("LD_PRELOAD") != NULL) {
     fprintf(stderr, "Error: LD_PRELOAD already set when running PLR\n");
     return 1;
@@ -140,11 +339,97 @@ int main(int argc, char *argv[]) {
     close(errFD);
   }
   
+  // Barrier latency grows linearly with the number of processes in the other
+  // barrier modes, so default to the tree barrier for large groups
+  if (!g_barrierModeSet && g_numRedunProc >= PLR_TREE_BARRIER_MIN_PROC) {
+    g_barrierMode = PLR_BARRIER_TREE;
+  }
+  // A pair's only compare runs as the barrier action of the last process
+  // to arrive, which the futex barrier runs without waking anyone up.
+  // Adaptive redundancy runs as a pair most of the time.
+  if (!g_barrierModeSet && (g_numRedunProc == 2 || g_adaptCleanMs > 0)) {
+    g_barrierMode = PLR_BARRIER_FUTEX;
+  }
+  // Quorum release is built on the futex barrier
+  if (g_quorum && !g_barrierModeSet) {
+    g_barrierMode = PLR_BARRIER_FUTEX;
+  }
+  
   int figPid = getpid();
   if (plr_figureheadInit(g_numRedunProc, g_pintoolMode, figPid, watchdogTimeout) < 0) {
     fprintf(stderr, "Error: PLR figurehead init failed\n");
     return 1;
   }
+  if (plr_figureheadSetBarrierMode(g_barrierMode) < 0) {
+    fprintf(stderr, "Error: PLR barrier mode setup failed\n");
+    return 1;
+  }
+  if (plr_figureheadSetSpinBudget(g_spinBudgetUs) < 0) {
+    fprintf(stderr, "Error: PLR spin budget setup failed\n");
+    return 1;
+  }
+  if (plr_figureheadSetQuorum(g_quorum) < 0) {
+    fprintf(stderr, "Error: PLR quorum mode setup failed\n");
+    return 1;
+  }
+  if (plr_figureheadSetAsyncLag(g_asyncLag) < 0) {
+    fprintf(stderr, "Error: PLR asynchronous mode setup failed\n");
+    return 1;
+  }
+  if (plr_figureheadSetEpochLength(g_epochLength) < 0) {
+    fprintf(stderr, "Error: PLR epoch length setup failed\n");
+    return 1;
+  }
+  if (plr_figureheadSetOutputBatching(g_outputBatchLimit) < 0) {
+    fprintf(stderr, "Error: PLR output batching setup failed\n");
+    return 1;
+  }
+  if (plr_figureheadSetCheckBudget(g_checkBudgetPct) < 0) {
+    fprintf(stderr, "Error: PLR plr_check budget setup failed\n");
+    return 1;
+  }
+  for (int cls = 0; cls < PLR_HASH_NCLASSES; ++cls) {
+    if (g_hashAlgo[cls] >= 0 && plr_figureheadSetHashAlgorithm(cls, g_hashAlgo[cls]) < 0) {
+      fprintf(stderr, "Error: PLR hash algorithm setup failed\n");
+      return 1;
+    }
+  }
+  if (g_recordLogFile != NULL && plr_figureheadSetRecordLog(g_recordLogFile) < 0) {
+    fprintf(stderr, "Error: PLR record mode setup failed\n");
+    return 1;
+  }
+  if (g_verifyLogFile != NULL && plr_figureheadSetVerifyLog(g_verifyLogFile) < 0) {
+    fprintf(stderr, "Error: PLR verify mode setup failed\n");
+    return 1;
+  }
+  if (plr_figureheadSetScrubbing(g_scrubInterval) < 0) {
+    fprintf(stderr, "Error: PLR memory scrubbing setup failed\n");
+    return 1;
+  }
+  if (g_adaptCleanMs > 0 && plr_figureheadSetAdaptiveRedundancy(g_adaptCleanMs) < 0) {
+    fprintf(stderr, "Error: PLR adaptive redundancy setup failed\n");
+    return 1;
+  }
+  if (g_ckptIntervalMs > 0
+      && plr_figureheadSetCheckpointing(g_ckptIntervalMs, g_ckptRetain ? g_ckptRetain : PLR_CKPT_DEFAULT_RETAIN) < 0) {
+    fprintf(stderr, "Error: PLR checkpointing setup failed\n");
+    return 1;
+  }
+  if (g_watchdogPercentile > 0
+      && plr_figureheadSetAdaptiveWatchdog(g_watchdogPercentile, g_watchdogMultiple, g_watchdogMinMs) < 0) {
+    fprintf(stderr, "Error: PLR adaptive watchdog setup failed\n");
+    return 1;
+  }
+  
+  // Block the figurehead's signals before starting the first process, so
+  // none sent by the redundant processes is lost before the event loop
+  sigemptyset(&g_superviseSigMask);
+  sigaddset(&g_superviseSigMask, SIGCHLD);
+  sigaddset(&g_superviseSigMask, PLR_FIGUREHEAD_WATCH_SIGNAL);
+  if (sigprocmask(SIG_BLOCK, &g_superviseSigMask, &g_origSigMask) < 0) {
+    perror("sigprocmask");
+    return 1;
+  }
   
   int ret = startFirstProcess(progArgc, progArgv);
   
@@ -157,16 +442,130 @@ int main(int argc, char *argv[]) {
     return 1;
   }
   
+  if (superviseProcesses(watchdogTimeout) < 0) {
+    return 1;
+  }
+  
+  if (plr_figureheadFaultDetected()) {
+    return PLR_FAULT_EXIT_STATUS;
+  }
+  
+  int logRet = plr_figureheadFinishLog();
+  if (logRet < 0) {
+    return 1;
+  } else if (logRet > 0) {
+    return PLR_FAULT_EXIT_STATUS;
+  }
+  
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void atexit_cleanupShm() {
+  if (g_watchdogStatsFile != NULL && plr_figureheadWriteWatchdogStats(g_watchdogStatsFile) < 0) {
+    fprintf(stderr, "Error: Writing PLR watchdog stats failed\n");
+  }
+  if (plr_figureheadExit() < 0) {
+    fprintf(stderr, "Error: PLR figurehead exit failed\n");
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Event loop of the figurehead, runs until all children exited. Watches
+// every redundant process through a pidfd, so a process that dies is
+// reported to the others right away instead of after a watchdog timeout.
+// Children (the first process & any reparented to the figurehead as
+// subreaper) are reaped through a SIGCHLD signalfd, which also receives
+// PLR_FIGUREHEAD_WATCH_SIGNAL when a new process needs to be watched.
+int superviseProcesses(long watchdogTimeout) {
+  int sigFd = signalfd(-1, &g_superviseSigMask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (sigFd < 0) {
+    perror("signalfd");
+    return -1;
+  }
+  
+  // fds[0] is the signalfd, followed by a pidfd for each slot in the shared
+  // data area (-1 while not watching a process)
+  struct pollfd fds[1+g_numRedunProc];
+  int watchedPids[g_numRedunProc];
+  fds[0].fd = sigFd;
+  fds[0].events = POLLIN;
+  for (int i = 0; i < g_numRedunProc; ++i) {
+    fds[1+i].fd = -1;
+    fds[1+i].events = POLLIN;
+    watchedPids[i] = 0;
+  }
+  
+  int ret = 0;
+  while (1) {
+    // Children are reaped on every pass, which also covers a SIGCHLD for a
+    // child that exited before the signalfd was created
+    int reapRet = reapChildren();
+    if (reapRet != 0) {
+      ret = (reapRet < 0) ? -1 : 0;
+      break;
+    }
+    
+    // Slots are rescanned on every pass, new processes announce themselves
+    // with PLR_FIGUREHEAD_WATCH_SIGNAL
+    watchProcesses(&fds[1], watchedPids);
+    if (poll(fds, 1+g_numRedunProc, watchdogTimeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("poll");
+      ret = -1;
+      break;
+    }
+    
+    if (fds[0].revents & POLLIN) {
+      struct signalfd_siginfo info;
+      while (read(sigFd, &info, sizeof(info)) == sizeof(info));
+    }
+    for (int i = 0; i < g_numRedunProc; ++i) {
+      if (fds[1+i].fd >= 0 && fds[1+i].revents) {
+        // pidfd is readable once the process exited. watchedPids keeps the
+        // pid so it isn't watched again until the slot changes.
+        plr_figureheadProcessDied(watchedPids[i]);
+        close(fds[1+i].fd);
+        fds[1+i].fd = -1;
+      }
+    }
+  }
+  
+  for (int i = 0; i < g_numRedunProc; ++i) {
+    if (fds[1+i].fd >= 0) {
+      close(fds[1+i].fd);
+    }
+  }
+  close(sigFd);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Reap all exited children without blocking.
+// Return value:
+//   < 0 : Error occured
+//     0 : Children remain
+//     1 : All children exited
+int reapChildren() {
   while (1) {
     int status;
-    int pid = wait(&status);
-    if (pid < 0) {
+    int pid = waitpid(-1, &status, WNOHANG);
+    if (pid == 0) {
+      return 0;
+    } else if (pid < 0) {
       if (errno == ECHILD) {
         plrlog(LOG_DEBUG, "PLR: All children exited\n");
-        break;
-      } else {
-        perror("wait");
         return 1;
+      } else if (errno == EINTR) {
+        continue;
+      } else {
+        perror("waitpid");
+        return -1;
       }
     } else if (WIFEXITED(status)) {
       plrlog(LOG_DEBUG, "Pid %d exited normally with status %d\n", pid, WEXITSTATUS(status));
@@ -175,16 +574,46 @@ int main(int argc, char *argv[]) {
     } else {
       plrlog(LOG_DEBUG, "Pid %d exited for unknown reason\n", pid);
     }
+    
+    // Also covers processes that couldn't be watched through a pidfd
+    plr_figureheadProcessDied(pid);
   }
-  
-  return 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void atexit_cleanupShm() {
-  if (plr_figureheadExit() < 0) {
-    fprintf(stderr, "Error: PLR figurehead exit failed\n");
+// Open a pidfd for every redundant process that isn't watched yet
+void watchProcesses(struct pollfd *pidFds, int *watchedPids) {
+  int pids[g_numRedunProc];
+  plr_figureheadGetProcPids(pids, g_numRedunProc);
+  for (int i = 0; i < g_numRedunProc; ++i) {
+    if (pids[i] == watchedPids[i]) {
+      continue;
+    }
+    if (pidFds[i].fd >= 0) {
+      close(pidFds[i].fd);
+      pidFds[i].fd = -1;
+    }
+    watchedPids[i] = pids[i];
+    if (pids[i] == 0) {
+      continue;
+    }
+    
+#ifdef SYS_pidfd_open
+    pidFds[i].fd = syscall(SYS_pidfd_open, pids[i], 0);
+#else
+    pidFds[i].fd = -1;
+    errno = ENOSYS;
+#endif
+    if (pidFds[i].fd < 0) {
+      if (errno == ESRCH) {
+        // Already gone before it could be watched
+        plr_figureheadProcessDied(pids[i]);
+      } else {
+        // No pidfd support, left to SIGCHLD & the watchdog
+        plrlog(LOG_DEBUG, "PLR: Can't watch pid %d, pidfd_open failed with errno %d\n", pids[i], errno);
+      }
+    }
   }
 }
 
@@ -209,6 +638,9 @@ int startFirstProcess(int argc, char **argv) {
     // Close read end of exec error handling pipe
     close(execErrPipe[0]);
     
+    // Don't pass the figurehead's blocked signals on to the program
+    sigprocmask(SIG_SETMASK, &g_origSigMask, NULL);
+    
     char **cArgv;
     if (g_pintoolMode != PINTOOL_MODE_OFF) {
       // Build child argv by appending pintool injection to front of command
@@ -294,5 +726,38 @@ void printUsage() {
     "  -p <trace|ins> Apply fault injection Pintool in either trace or instruction mode\n"
     "  -m <long>      Mean number of trace/instructions before fault injection\n"
     "  -t <int>       Watchdog timeout interval, in ms (default=200ms)\n"
-    "  -n <int>       Number of redundant processes to create (default=3)\n");
+    "  -n <int>       Number of redundant processes to create (default=3). With 2, faults\n"
+    "                 are only detected, & plr exits with status 3 when they disagree\n"
+    "  -b <mode>      Barrier implementation, \"cond\", \"futex\" or \"tree\"\n"
+    "                 (default=cond, futex with 2 & tree with 5 or more redundant processes)\n"
+    "  -s <int>       Busy-poll at barriers for up to this many us before sleeping (default=0)\n"
+    "  -q             Let a majority of processes continue past checked syscalls without\n"
+    "                 waiting for the slowest one (implies -b futex)\n"
+    "  -A <int>       Asynchronous mode, the master doesn't wait for the other processes,\n"
+    "                 which check its syscalls up to this many syscalls behind\n"
+    "  -E <int>       Fold the checks of calls without external effects (getpid, close,\n"
+    "                 fseek) into a hash & only compare it once every this many calls\n"
+    "  -B <long>      Batch output to pipes, sockets & ttys, check & write it only at\n"
+    "                 fflush, fclose, close, input, exit, output to another fd, or once\n"
+    "                 this many bytes are queued; stderr isn't batched\n"
+    "  -K <int>       Percentage of the run time plr_check() calls of the program may\n"
+    "                 spend hashing, skipping calls as needed (default=10)\n"
+    "  -S <int>       Scrub the program's writable data every this many checked syscalls,\n"
+    "                 replacing processes whose data disagrees\n"
+    "  -H <cls>=<alg> Hash algorithm, \"crc32c\" or \"xxh\", for a class of checked data:\n"
+    "                 \"name\" (paths & other strings, default=crc32c), \"data\" (output,\n"
+    "                 default=xxh) or \"state\" (plr_check() & -S memory, default=xxh)\n"
+    "  -r <long>      Adaptive redundancy, run 2 processes until a faulted one is replaced,\n"
+    "                 then -n processes until this many ms pass without a fault\n"
+    "  -c <long>      Checkpoint every this many ms, & roll back to the last checkpoint\n"
+    "                 instead of exiting when no majority of processes agrees\n"
+    "  -C <int>       Number of checkpoints kept by -c (default=2)\n"
+    "  -a <int>       Adapt the watchdog timeout of each wrapped call to a multiple of this\n"
+    "                 percentile of the replicas' arrival skew, up to the -t timeout\n"
+    "  -k <int>       Multiple of the skew percentile used by -a (default=4)\n"
+    "  -l <int>       Minimum watchdog timeout used by -a, in ms (default=10ms)\n"
+    "  -W <file>      Write the skew & timeout learned by -a for each wrapped call to file\n"
+    "  -R <file>      Record mode, run a single process & log its checked syscalls to file\n"
+    "  -V <file>      Verify mode, check the -n processes against the log recorded with -R,\n"
+    "                 exiting with status 3 if any of them diverges from it\n");
 }
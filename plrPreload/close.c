@@ -3,6 +3,7 @@
 #include "plr.h"
 #include "plrLog.h"
 #include "libc_func.h"
+#include "outputBatch.h"
 
 #include <stdio.h>
 
@@ -18,14 +19,26 @@ int close(int fd) {
     plr_setInsidePLR();
     plrlog(LOG_SYSCALL, "[%d:close] Close fd %d\n", getpid(), fd);
     
+    // Write out output queued for the fd, a failure is returned like the
+    // write error of a buffered stream
+    int flushRet = 0;
+    int flushErr = 0;
+    if (outBatch_isEnabled() && (flushRet = outBatch_flush(fd)) < 0) {
+      flushErr = errno;
+    }
+    
     syscallArgs_t args = {
       .addr = _off_close,
       .arg[0] = fd,
     };
-    plr_checkSyscallArgs(&args);
+    plr_foldSyscallArgs(&args);
     
     // Call original libc function
     ret = _close(fd);
+    if (flushRet < 0) {
+      ret = -1;
+      errno = flushErr;
+    }
     
     plr_clearInsidePLR();
   }
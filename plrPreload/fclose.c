@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include "plr.h"
+#include "plrLog.h"
+#include "libc_func.h"
+#include "outputBatch.h"
+
+int fclose(FILE *stream) {
+  // Get libc syscall function pointer & offset in image
+  libc_func(fclose, int, FILE *);
+    
+  int ret;
+  if (plr_checkInsidePLR()) {
+    // If already inside PLR code, just call original syscall & return
+    ret = _fclose(stream);
+  } else {
+    plr_setInsidePLR();
+    int fn = fileno(stream);
+    plrlog(LOG_SYSCALL, "[%d:fclose] Close fileno %d\n", getpid(), fn);
+    
+    // Write out output queued for the stream's fd
+    int flushRet = 0;
+    int flushErr = 0;
+    if (outBatch_isEnabled() && (flushRet = outBatch_flush(fn)) < 0) {
+      flushErr = errno;
+    }
+    
+    // Call original libc function
+    ret = _fclose(stream);
+    if (flushRet < 0) {
+      ret = EOF;
+      errno = flushErr;
+    }
+    
+    plr_clearInsidePLR();
+  }
+  
+  return ret;
+}
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include "plr.h"
+#include "plrLog.h"
+#include "libc_func.h"
+#include "outputBatch.h"
+
+int fflush(FILE *stream) {
+  // Get libc syscall function pointer & offset in image
+  libc_func(fflush, int, FILE *);
+    
+  int ret;
+  if (plr_checkInsidePLR()) {
+    // If already inside PLR code, just call original syscall & return
+    ret = _fflush(stream);
+  } else {
+    plr_setInsidePLR();
+    int fn = (stream) ? fileno(stream) : -1;
+    plrlog(LOG_SYSCALL, "[%d:fflush] Flush fileno %d\n", getpid(), fn);
+    
+    // Write out output queued for the stream's fd, or for all fds when
+    // flushing all streams
+    int flushRet = 0;
+    int flushErr = 0;
+    if (outBatch_isEnabled() && (flushRet = outBatch_flush(fn)) < 0) {
+      flushErr = errno;
+    }
+    
+    // Call original libc function
+    ret = _fflush(stream);
+    if (flushRet < 0) {
+      ret = EOF;
+      errno = flushErr;
+    }
+    
+    plr_clearInsidePLR();
+  }
+  
+  return ret;
+}
@@ -6,7 +6,7 @@
 #include "plr.h"
 #include "plrLog.h"
 #include "libc_func.h"
-#include "crc32_util.h"
+#include "outputBatch.h"
 
 typedef struct {
   int err;
@@ -28,12 +28,17 @@ int com_fgetc(const char *fncName, FILE *stream) {
     int fn = fileno(stream);
     plrlog(LOG_SYSCALL, "[%d:%s] Read char from fileno %d\n", getpid(), fncName, fn);
     
+    if (outBatch_isEnabled()) {
+      // Output queued for any fd is written out before reading, so that
+      // e.g. a prompt on stdout shows up before the read from stdin
+      outBatch_flush(-1);
+    }
+    
     syscallArgs_t args = {
       .addr = _off_fgetc,
-      .arg[0] = crc32(0, fncName, strlen(fncName)),
+      .arg[0] = plr_hash(PLR_HASH_NAME, 0, fncName, strlen(fncName)),
       .arg[1] = fn,
     };
-    plr_checkSyscallArgs(&args);
     
     // Nested function actually performed by master process only
     int ret;
@@ -48,6 +53,10 @@ int com_fgetc(const char *fncName, FILE *stream) {
       shmDat.offs = ftell(stream);
       shmDat.eof = feof(stream);
       shmDat.ferr = ferror(stream);
+      if (shmDat.eof) {
+        // Slaves read at EOF to set their own EOF flag
+        plr_waitForSlavesAfterAction();
+      }
       
       // Store return value & returned data in shared memory for slave processes
       plr_copyToShm(&shmDat, sizeof(shmDat), 0);
@@ -61,10 +70,11 @@ int com_fgetc(const char *fncName, FILE *stream) {
       
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedMasterAction() to check arguments &
+    // synchronize at this point
+    plr_checkedMasterAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
       
@@ -93,13 +103,13 @@ int com_fgetc(const char *fncName, FILE *stream) {
     // TEMPORARY
     // Slave processes sometimes end up with the wrong file offset, even after SEEK_SET
     // Compare file state at exit to make sure everything is consistent
-    // Piggybacking off checkSyscallArgs mechanism to do this
+    // Deferred so it gets checked along with the next syscall's arguments
     syscallArgs_t exitState = {
       .arg[0] = ftell(stream),
       .arg[1] = feof(stream),
       .arg[2] = ferror(stream),
     };
-    plr_checkSyscallArgs(&exitState);
+    plr_deferSyscallArgsCheck(&exitState);
     
     // All procs return same value & errno
     ret = shmDat.ret;
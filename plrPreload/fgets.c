@@ -6,7 +6,7 @@
 #include "plr.h"
 #include "plrLog.h"
 #include "libc_func.h"
-#include "crc32_util.h"
+#include "outputBatch.h"
 
 typedef struct {
   int err;
@@ -15,6 +15,8 @@ typedef struct {
   long offs;
   int eof;
   int ferr;
+  // Digest of the string read, checked by the slaves as they copy it
+  unsigned long digest;
 } fgetsShmData_t;
 
 char *fgets(char *s, int size, FILE *stream) {
@@ -29,12 +31,17 @@ char *fgets(char *s, int size, FILE *stream) {
     int fn = fileno(stream);
     plrlog(LOG_SYSCALL, "[%d:fgets] Read line from fileno %d\n", getpid(), fn);
     
+    if (outBatch_isEnabled()) {
+      // Output queued for any fd is written out before reading, so that
+      // e.g. a prompt on stdout shows up before the read from stdin
+      outBatch_flush(-1);
+    }
+    
     syscallArgs_t args = {
       .addr = _off_fgets,
       .arg[0] = fn,
       .arg[1] = size
     };
-    plr_checkSyscallArgs(&args);
     
     // Nested function actually performed by master process only
     char *ret;
@@ -50,12 +57,14 @@ char *fgets(char *s, int size, FILE *stream) {
       shmDat.offs = ftell(stream);
       shmDat.eof = feof(stream);
       shmDat.ferr = ferror(stream);
+      if (shmDat.eof) {
+        // Slaves read at EOF to set their own EOF flag
+        plr_waitForSlavesAfterAction();
+      }
       
       // Store return value & returned data in shared memory for slave processes
+      shmDat.digest = (shmDat.retNull) ? 0 : plr_copyToShmHashed(s, shmDat.sLen, sizeof(shmDat));
       plr_copyToShm(&shmDat, sizeof(shmDat), 0);
-      if (!shmDat.retNull) {
-        plr_copyToShm(s, shmDat.sLen, sizeof(shmDat));
-      }
       
       if (shmDat.ferr) {
         // Not sure how to handle passing ferror's to slaves yet, no way 
@@ -66,14 +75,15 @@ char *fgets(char *s, int size, FILE *stream) {
       
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedMasterAction() to check arguments &
+    // synchronize at this point
+    plr_checkedMasterAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
       if (!shmDat.retNull) {
-        plr_copyFromShm(s, shmDat.sLen, sizeof(shmDat));
+        plr_copyFromShmChecked(s, shmDat.sLen, sizeof(shmDat), shmDat.digest);
       }
       
       // Slaves seek to new fd offset
@@ -101,13 +111,13 @@ char *fgets(char *s, int size, FILE *stream) {
     // TEMPORARY
     // Slave processes sometimes end up with the wrong file offset, even after SEEK_SET
     // Compare file state at exit to make sure everything is consistent
-    // Piggybacking off checkSyscallArgs mechanism to do this
+    // Deferred so it gets checked along with the next syscall's arguments
     syscallArgs_t exitState = {
       .arg[0] = ftell(stream),
       .arg[1] = feof(stream),
       .arg[2] = ferror(stream),
     };
-    plr_checkSyscallArgs(&exitState);
+    plr_deferSyscallArgsCheck(&exitState);
     
     // All procs return same value & errno
     ret = (shmDat.retNull) ? NULL : s;
@@ -1,23 +1,37 @@
+// _GNU_SOURCE for memfd_create
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
+#include <sys/mman.h>
 #include "plr.h"
 #include "plrLog.h"
 #include "libc_func.h"
-#include "crc32_util.h"
 
 typedef struct {
   int err;
   int failed;
 } fopenShmData_t;
 
+///////////////////////////////////////////////////////////////////////////////
+// Private functions
+
+static FILE *fopenNoTrunc(const char *path, const char *mode);
+
+///////////////////////////////////////////////////////////////////////////////
+
 FILE *fopen(const char *path, const char *mode) {
   // Get libc syscall function pointer & offset in image
   libc_func(fopen, FILE *, const char *, const char *);
   
   // If already inside PLR code, just call original syscall & return
   if (plr_checkInsidePLR()) {
+    if (plr_skipPausedEffect() && mode[0] == 'w') {
+      // Unprotected region, only the master truncates the file
+      return fopenNoTrunc(path, mode);
+    }
     // Call original libc function
     return _fopen(path, mode);
   } else {
@@ -26,12 +40,11 @@ FILE *fopen(const char *path, const char *mode) {
     
     syscallArgs_t args = {
       .addr = _off_fopen,
-      .arg[0] = crc32(0, path, strlen(path)),
-      .arg[1] = crc32(0, mode, strlen(mode)),
+      .arg[0] = plr_hash(PLR_HASH_NAME, 0, path, strlen(path)),
+      .arg[1] = plr_hash(PLR_HASH_NAME, 0, mode, strlen(mode)),
     };
-    plr_checkSyscallArgs(&args);
     
-    // Nested function actually performed by master process only
+    // Nested function actually performed by the executor process only
     FILE *ret;
     int masterAct() {
       // Hacky workaround...this makes sure the fd for the extraShm area
@@ -41,16 +54,20 @@ FILE *fopen(const char *path, const char *mode) {
       
       // Call original libc function
       ret = _fopen(path, mode);
+      // Slaves open the file themselves, which must happen before the
+      // master changes it
+      plr_waitForSlavesAfterAction();
       
       // Store return value in shared memory for slave processes
       fopenShmData_t shmDat = { .err = errno, .failed = (ret == NULL) };
       plr_copyToShm(&shmDat, sizeof(shmDat), 0);
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedExecutorAction() to check arguments &
+    // synchronize at this point
+    plr_checkedExecutorAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       fopenShmData_t shmDat;
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
@@ -58,6 +75,15 @@ FILE *fopen(const char *path, const char *mode) {
       // If error occurred in master, just return master's values
       if (shmDat.failed) {
         errno = shmDat.err;
+      } else if (plr_isVerifying()) {
+        // Verifiers get their results from the log & must not change the
+        // file, so they use an anonymous file in its place
+        int fd = memfd_create(path, strchr(mode, 'e') ? MFD_CLOEXEC : 0);
+        ret = (fd < 0) ? NULL : fdopen(fd, mode);
+      } else if (plr_isReplaying() && mode[0] == 'w') {
+        // Replaying after a rollback, the file was already created &
+        // written by the rolled back run, so open it without truncating
+        ret = fopenNoTrunc(path, mode);
       } else {
         // Call original libc function
         ret = _fopen(path, mode);
@@ -68,3 +94,21 @@ FILE *fopen(const char *path, const char *mode) {
     return ret;
   }
 }
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Opens path for writing like a "w" mode, but without truncating the file or
+// failing if it exists, for processes opening a file that another process
+// creates & writes
+static FILE *fopenNoTrunc(const char *path, const char *mode) {
+  int flags = O_CREAT | (strchr(mode, '+') ? O_RDWR : O_WRONLY) | (strchr(mode, 'e') ? O_CLOEXEC : 0);
+  int fd = open(path, flags, 0666);
+  if (fd < 0) {
+    return NULL;
+  }
+  FILE *ret = fdopen(fd, mode);
+  if (ret == NULL) {
+    close(fd);
+  }
+  return ret;
+}
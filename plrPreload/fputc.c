@@ -8,7 +8,7 @@
 #include "plrLog.h"
 #include "plrSharedData.h"
 #include "libc_func.h"
-#include "crc32_util.h"
+#include "outputBatch.h"
 
 typedef struct {
   int err;
@@ -22,7 +22,10 @@ int com_fputc(const char *fncName, int c, FILE *stream) {
   // Get libc syscall function pointer & offset in image
   libc_func(fputc, int, int, FILE *);
     
-  if (plr_checkInsidePLR()) {
+  if (plr_skipPausedEffect()) {
+    // Unprotected region, only the master writes the output
+    return (unsigned char)c;
+  } else if (plr_checkInsidePLR()) {
     // If already inside PLR code, just call original syscall & return
     return _fputc(c, stream);
   } else {
@@ -30,13 +33,20 @@ int com_fputc(const char *fncName, int c, FILE *stream) {
     int fn = fileno(stream);
     plrlog(LOG_SYSCALL, "[%d:%s] Write '%c' to fileno %d\n", getpid(), fncName, c, fn);
     
+    if (outBatch_isBatched(fn)) {
+      // Queue the data, it's checked & written out at the next flush point
+      unsigned char uc = c;
+      int ret = (outBatch_append(fn, &uc, 1) < 0) ? EOF : uc;
+      plr_clearInsidePLR();
+      return ret;
+    }
+    
     syscallArgs_t args = {
       .addr = _off_fputc,
-      .arg[0] = crc32(0, fncName, strlen(fncName)),
+      .arg[0] = plr_hash(PLR_HASH_NAME, 0, fncName, strlen(fncName)),
       .arg[1] = fn,
       .arg[2] = c,
     };
-    plr_checkSyscallArgs(&args);
     
     // Nested function actually performed by master process only
     int ret;
@@ -55,6 +65,10 @@ int com_fputc(const char *fncName, int c, FILE *stream) {
       shmDat.offs = ftell(stream);
       shmDat.eof = feof(stream);
       shmDat.ferr = ferror(stream);
+      if (shmDat.eof) {
+        // Slaves read at EOF to set their own EOF flag
+        plr_waitForSlavesAfterAction();
+      }
       
       // Store return value in shared memory for slave processes
       plr_copyToShm(&shmDat, sizeof(shmDat), 0);
@@ -68,10 +82,11 @@ int com_fputc(const char *fncName, int c, FILE *stream) {
       
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedMasterAction() to check arguments &
+    // synchronize at this point
+    plr_checkedMasterAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
       
@@ -100,13 +115,13 @@ int com_fputc(const char *fncName, int c, FILE *stream) {
     // TEMPORARY
     // Slave processes sometimes end up with the wrong file offset, even after SEEK_SET
     // Compare file state at exit to make sure everything is consistent
-    // Piggybacking off checkSyscallArgs mechanism to do this
+    // Deferred so it gets checked along with the next syscall's arguments
     syscallArgs_t exitState = {
       .arg[0] = ftell(stream),
       .arg[1] = feof(stream),
       .arg[2] = ferror(stream),
     };
-    plr_checkSyscallArgs(&exitState);
+    plr_deferSyscallArgsCheck(&exitState);
     
     // All procs return same value & errno
     ret = shmDat.ret;
@@ -8,7 +8,7 @@
 #include "plrLog.h"
 #include "plrSharedData.h"
 #include "libc_func.h"
-#include "crc32_util.h"
+#include "outputBatch.h"
 
 typedef struct {
   int err;
@@ -22,7 +22,10 @@ int fputs(const char *s, FILE *stream) {
   // Get libc syscall function pointer & offset in image
   libc_func(fputs, int, const char *, FILE *);
     
-  if (plr_checkInsidePLR()) {
+  if (plr_skipPausedEffect()) {
+    // Unprotected region, only the master writes the output
+    return 1;
+  } else if (plr_checkInsidePLR()) {
     // If already inside PLR code, just call original syscall & return
     return _fputs(s, stream);
   } else {
@@ -30,12 +33,18 @@ int fputs(const char *s, FILE *stream) {
     int fn = fileno(stream);
     plrlog(LOG_SYSCALL, "[%d:fputs] Write '%s' to fileno %d\n", getpid(), s, fn);
     
+    if (outBatch_isBatched(fn)) {
+      // Queue the data, it's checked & written out at the next flush point
+      int ret = (outBatch_append(fn, s, strlen(s)) < 0) ? EOF : 1;
+      plr_clearInsidePLR();
+      return ret;
+    }
+    
     syscallArgs_t args = {
       .addr = _off_fputs,
       .arg[0] = fn,
-      .arg[1] = crc32(0, s, strlen(s)),
+      .arg[1] = plr_hash(PLR_HASH_DATA, 0, s, strlen(s)),
     };
-    plr_checkSyscallArgs(&args);
     
     // Nested function actually performed by master process only
     int ret;
@@ -54,6 +63,10 @@ int fputs(const char *s, FILE *stream) {
       shmDat.offs = ftell(stream);
       shmDat.eof = feof(stream);
       shmDat.ferr = ferror(stream);
+      if (shmDat.eof) {
+        // Slaves read at EOF to set their own EOF flag
+        plr_waitForSlavesAfterAction();
+      }
       
       // Store return value in shared memory for slave processes
       plr_copyToShm(&shmDat, sizeof(shmDat), 0);
@@ -67,10 +80,11 @@ int fputs(const char *s, FILE *stream) {
       
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedMasterAction() to check arguments &
+    // synchronize at this point
+    plr_checkedMasterAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
       
@@ -99,13 +113,13 @@ int fputs(const char *s, FILE *stream) {
     // TEMPORARY
     // Slave processes sometimes end up with the wrong file offset, even after SEEK_SET
     // Compare file state at exit to make sure everything is consistent
-    // Piggybacking off checkSyscallArgs mechanism to do this
+    // Deferred so it gets checked along with the next syscall's arguments
     syscallArgs_t exitState = {
       .arg[0] = ftell(stream),
       .arg[1] = feof(stream),
       .arg[2] = ferror(stream),
     };
-    plr_checkSyscallArgs(&exitState);
+    plr_deferSyscallArgsCheck(&exitState);
     
     // All procs return same value & errno
     ret = shmDat.ret;
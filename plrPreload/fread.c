@@ -5,7 +5,7 @@
 #include "plr.h"
 #include "plrLog.h"
 #include "libc_func.h"
-#include "crc32_util.h"
+#include "outputBatch.h"
 
 typedef struct {
   int err;
@@ -13,6 +13,8 @@ typedef struct {
   long offs;
   int eof;
   int ferr;
+  // Digest of the data read, checked by the slaves as they copy it
+  unsigned long digest;
 } freadShmData_t;
 
 size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream) {
@@ -27,13 +29,18 @@ size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream) {
     int fn = fileno(stream);
     plrlog(LOG_SYSCALL, "[%d:fread] Read %ld %ld-byte elems from fileno %d\n", getpid(), nmemb, size, fn);
     
+    if (outBatch_isEnabled()) {
+      // Output queued for any fd is written out before reading, so that
+      // e.g. a prompt on stdout shows up before the read from stdin
+      outBatch_flush(-1);
+    }
+    
     syscallArgs_t args = {
       .addr = _off_fread,
       .arg[0] = fn,
       .arg[1] = size,
       .arg[2] = nmemb,
     };
-    plr_checkSyscallArgs(&args);
     
     // Nested function actually performed by master process only
     size_t ret;
@@ -48,10 +55,15 @@ size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream) {
       shmDat.offs = ftell(stream);
       shmDat.eof = feof(stream);
       shmDat.ferr = ferror(stream);
+      if (shmDat.eof) {
+        // Slaves read at EOF to set their own EOF flag
+        plr_waitForSlavesAfterAction();
+      }
       
-      // Store return value & returned data in shared memory for slave processes
+      // Store return value & returned data in shared memory for slave
+      // processes. ret counts elements, the data is ret*size bytes.
+      shmDat.digest = plr_copyToShmHashed(ptr, ret*size, sizeof(shmDat));
       plr_copyToShm(&shmDat, sizeof(shmDat), 0);
-      plr_copyToShm(ptr, ret, sizeof(shmDat));
       
       if (shmDat.ferr) {
         // Not sure how to handle passing ferror's to slaves yet, no way
@@ -62,14 +74,15 @@ size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream) {
       
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedMasterAction() to check arguments &
+    // synchronize at this point
+    plr_checkedMasterAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
       if (shmDat.ret > 0) {
-        plr_copyFromShm(ptr, shmDat.ret, sizeof(shmDat));
+        plr_copyFromShmChecked(ptr, shmDat.ret*size, sizeof(shmDat), shmDat.digest);
       }
       
       // Slaves seek to new fd offset
@@ -97,13 +110,13 @@ size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream) {
     // TEMPORARY
     // Slave processes sometimes end up with the wrong file offset, even after SEEK_SET
     // Compare file state at exit to make sure everything is consistent
-    // Piggybacking off checkSyscallArgs mechanism to do this
+    // Deferred so it gets checked along with the next syscall's arguments
     syscallArgs_t exitState = {
       .arg[0] = ftell(stream),
       .arg[1] = feof(stream),
       .arg[2] = ferror(stream),
     };
-    plr_checkSyscallArgs(&exitState);
+    plr_deferSyscallArgsCheck(&exitState);
     
     // All procs return same value & errno
     ret = shmDat.ret;
@@ -7,7 +7,7 @@
 #include "plrLog.h"
 #include "plrSharedData.h"
 #include "libc_func.h"
-#include "crc32_util.h"
+#include "outputBatch.h"
 
 typedef struct {
   int err;
@@ -21,7 +21,10 @@ size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream) {
   // Get libc syscall function pointer & offset in image
   libc_func(fwrite, size_t, const void *, size_t, size_t, FILE *);
     
-  if (plr_checkInsidePLR()) {
+  if (plr_skipPausedEffect()) {
+    // Unprotected region, only the master writes the output
+    return nmemb;
+  } else if (plr_checkInsidePLR()) {
     // If already inside PLR code, just call original syscall & return
     return _fwrite(ptr, size, nmemb, stream);
   } else {
@@ -29,14 +32,20 @@ size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream) {
     int fn = fileno(stream);
     plrlog(LOG_SYSCALL, "[%d:fwrite] Write %ld %ld-byte elems to fileno %d\n", getpid(), nmemb, size, fn);
     
+    if (outBatch_isBatched(fn)) {
+      // Queue the data, it's checked & written out at the next flush point
+      size_t ret = (outBatch_append(fn, ptr, size*nmemb) < 0) ? 0 : nmemb;
+      plr_clearInsidePLR();
+      return ret;
+    }
+    
     syscallArgs_t args = {
       .addr = _off_fwrite,
       .arg[0] = fn,
       .arg[1] = size,
       .arg[2] = nmemb,
-      .arg[3] = crc32(0, ptr, size*nmemb),
+      .arg[3] = plr_hash(PLR_HASH_DATA, 0, ptr, size*nmemb),
     };
-    plr_checkSyscallArgs(&args);
     
     // Nested function actually performed by master process only
     size_t ret;
@@ -55,6 +64,10 @@ size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream) {
       shmDat.offs = ftell(stream);
       shmDat.eof = feof(stream);
       shmDat.ferr = ferror(stream);
+      if (shmDat.eof) {
+        // Slaves read at EOF to set their own EOF flag
+        plr_waitForSlavesAfterAction();
+      }
       
       // Store return value in shared memory for slave processes
       plr_copyToShm(&shmDat, sizeof(shmDat), 0);
@@ -68,10 +81,11 @@ size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream) {
       
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedMasterAction() to check arguments &
+    // synchronize at this point
+    plr_checkedMasterAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
       
@@ -100,13 +114,13 @@ size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream) {
     // TEMPORARY
     // Slave processes sometimes end up with the wrong file offset, even after SEEK_SET
     // Compare file state at exit to make sure everything is consistent
-    // Piggybacking off checkSyscallArgs mechanism to do this
+    // Deferred so it gets checked along with the next syscall's arguments
     syscallArgs_t exitState = {
       .arg[0] = ftell(stream),
       .arg[1] = feof(stream),
       .arg[2] = ferror(stream),
     };
-    plr_checkSyscallArgs(&exitState);
+    plr_deferSyscallArgsCheck(&exitState);
     
     // All procs return same value & errno
     ret = shmDat.ret;
@@ -19,14 +19,14 @@ pid_t getpid() {
     plr_setInsidePLR();
     
     // Return figurehead PID
-    pid_t ret = plrShm->figureheadPid;
+    pid_t ret = plrShm->appPid;
     
     plrlog(LOG_SYSCALL, "[%d:getpid] Returning figurehead PID %d\n", _getpid(), ret);
     
     syscallArgs_t args = {
       .addr = _off_getpid,
     };
-    plr_checkSyscallArgs(&args);
+    plr_foldSyscallArgs(&args);
     
     plr_clearInsidePLR();
     return ret;
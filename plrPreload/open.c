@@ -1,3 +1,5 @@
+// _GNU_SOURCE for memfd_create
+#define _GNU_SOURCE
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -5,10 +7,10 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/mman.h>
 #include "plr.h"
 #include "plrLog.h"
 #include "libc_func.h"
-#include "crc32_util.h"
 
 typedef struct {
   int err;
@@ -29,6 +31,10 @@ int commonOpen(const char *fncName, const char *pathname, int flags, va_list arg
   
   // If already inside PLR code, just call original syscall & return
   if (plr_checkInsidePLR()) {
+    if (plr_skipPausedEffect()) {
+      // Unprotected region, only the master creates or truncates the file
+      flags &= ~(O_TRUNC | O_EXCL);
+    }
     // Call original libc function
     int ret;
     if (flags & O_CREAT) {
@@ -43,13 +49,12 @@ int commonOpen(const char *fncName, const char *pathname, int flags, va_list arg
     
     syscallArgs_t args = {
       .addr = _off_open,
-      .arg[0] = crc32(0, pathname, strlen(pathname)),
+      .arg[0] = plr_hash(PLR_HASH_NAME, 0, pathname, strlen(pathname)),
       .arg[1] = flags,
       .arg[2] = mode
     };
-    plr_checkSyscallArgs(&args);
     
-    // Nested function actually performed by master process only
+    // Nested function actually performed by the executor process only
     // If O_EXCL specified in flags, master process creates file (or errors out)
     int ret;
     int masterAct() {
@@ -64,16 +69,20 @@ int commonOpen(const char *fncName, const char *pathname, int flags, va_list arg
       } else {
         ret = _open(pathname, flags);
       }
+      // Slaves open the file themselves, which must happen before the
+      // master changes it
+      plr_waitForSlavesAfterAction();
       
       // Store return value in shared memory for slave processes
       openShmData_t shmDat = { .err = errno, .ret = ret };
       plr_copyToShm(&shmDat, sizeof(shmDat), 0);
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedExecutorAction() to check arguments &
+    // synchronize at this point
+    plr_checkedExecutorAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       openShmData_t shmDat;
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
@@ -82,12 +91,22 @@ int commonOpen(const char *fncName, const char *pathname, int flags, va_list arg
       if (shmDat.ret < 0) {
         ret = shmDat.ret;
         errno = shmDat.err;
+      } else if (plr_isVerifying()) {
+        // Verifiers get their results from the log & must not change the
+        // file, so they use an anonymous file in its place
+        ret = memfd_create(pathname, (flags & O_CLOEXEC) ? MFD_CLOEXEC : 0);
       } else {
-        // Call original libc function, removing O_EXCL flag if it is given
+        // Call original libc function, removing O_EXCL flag if it is given.
+        // When replaying after a rollback, the rolled back run already
+        // truncated & wrote the file.
+        int slaveFlags = flags & ~O_EXCL;
+        if (plr_isReplaying()) {
+          slaveFlags &= ~O_TRUNC;
+        }
         if (flags & O_CREAT) {
-          ret = _open(pathname, flags & ~O_EXCL, mode);
+          ret = _open(pathname, slaveFlags, mode);
         } else {
-          ret = _open(pathname, flags & ~O_EXCL);
+          ret = _open(pathname, slaveFlags);
         }
       }
     }
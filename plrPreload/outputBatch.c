@@ -0,0 +1,190 @@
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "plr.h"
+#include "plrLog.h"
+#include "libc_func.h"
+#include "outputBatch.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Global variables & defines
+
+// Output is queued for one fd at a time, so that it's written out in the
+// same order the program produced it, even across fds that share a file
+typedef struct {
+  // fd the output goes to, -1 while nothing is queued
+  int fd;
+  char *buf;
+  size_t len;
+  size_t size;
+  // Digest of all queued data, checked at the flush
+  unsigned long digest;
+} outBatchQueue_t;
+
+typedef struct {
+  int err;
+  ssize_t ret;
+  off_t offs;
+} outBatchShmData_t;
+
+static outBatchQueue_t g_queue = { .fd = -1 };
+
+///////////////////////////////////////////////////////////////////////////////
+// Private functions
+
+static int flushQueue(outBatchQueue_t *queue);
+static int isUnseekable(int fd);
+
+///////////////////////////////////////////////////////////////////////////////
+
+int outBatch_isEnabled() {
+  return plr_outputBatchLimit() > 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int outBatch_isBatched(int fd) {
+  if (!outBatch_isEnabled()) {
+    return 0;
+  } else if (g_queue.fd == fd) {
+    // Only output to fds that are batched is queued
+    return 1;
+  } else if (isUnseekable(fd)) {
+    return 1;
+  }
+  
+  // A failed flush was already logged, the caller's output goes ahead anyway
+  if (g_queue.fd != -1) {
+    flushQueue(&g_queue);
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int outBatch_append(int fd, const void *buf, size_t count) {
+  outBatchQueue_t *queue = &g_queue;
+  if (queue->fd != fd) {
+    // Output switches to another fd, write out what came before it first
+    if (queue->fd != -1 && flushQueue(queue) < 0) {
+      return -1;
+    }
+    queue->fd = fd;
+  }
+  
+  if (queue->len + count > queue->size) {
+    size_t newSize = (queue->size) ? queue->size : 4096;
+    while (newSize < queue->len + count) {
+      newSize *= 2;
+    }
+    char *newBuf = realloc(queue->buf, newSize);
+    if (newBuf == NULL) {
+      plrlog(LOG_ERROR, "[%d] ERROR: Failed to grow output batch for fd %d to %zu bytes\n", getpid(), fd, newSize);
+      exit(1);
+    }
+    queue->buf = newBuf;
+    queue->size = newSize;
+  }
+  // Copied & hashed in a single pass over the data
+  queue->digest = plr_copyHash(PLR_HASH_DATA, queue->digest, queue->buf + queue->len, buf, count);
+  queue->len += count;
+  
+  // stderr stays unbuffered, its output is only queued to check it the
+  // same way as the rest
+  if (fd == STDERR_FILENO || queue->len >= (size_t)plr_outputBatchLimit()) {
+    return flushQueue(queue);
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int outBatch_flush(int fd) {
+  if (g_queue.fd != -1 && (fd == -1 || g_queue.fd == fd)) {
+    return flushQueue(&g_queue);
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int flushQueue(outBatchQueue_t *queue) {
+  // Get libc syscall function pointer & offset in image
+  libc_func(write, ssize_t, int, const void *, size_t);
+  
+  int fd = queue->fd;
+  queue->fd = -1;
+  if (queue->len == 0) {
+    return 0;
+  }
+  plrlog(LOG_SYSCALL, "[%d:write] Flush %zu batched bytes to fd %d\n", getpid(), queue->len, fd);
+  
+  // One check for the whole batch, through the digest of all of its data
+  syscallArgs_t args = {
+    .addr = _off_write,
+    .arg[0] = fd,
+    .arg[1] = queue->digest,
+    .arg[2] = queue->len,
+  };
+  
+  // Nested function actually performed by the executor process only
+  outBatchShmData_t shmDat;
+  int masterAct() {
+    // Call original libc function until the whole batch is written
+    size_t done = 0;
+    shmDat.ret = 0;
+    while (done < queue->len) {
+      ssize_t ret = _write(fd, queue->buf + done, queue->len - done);
+      if (ret < 0 && errno != EINTR) {
+        shmDat.ret = -1;
+        break;
+      } else if (ret > 0) {
+        done += ret;
+      }
+    }
+    shmDat.err = errno;
+    
+    // Use lseek to get new file offset
+    shmDat.offs = (shmDat.ret != -1) ? lseek(fd, 0, SEEK_CUR) : -1;
+    
+    // Store return value in shared memory for slave processes
+    plr_copyToShm(&shmDat, sizeof(shmDat), 0);
+    return 0;
+  }
+  // All processes call plr_checkedExecutorAction() to check arguments &
+  // synchronize at this point
+  plr_checkedExecutorAction(&args, masterAct);
+  
+  if (!plr_isExecutorProcess()) {
+    // Slaves copy return values from shared memory
+    plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
+    
+    // Slaves seek to new fd offset, see write()
+    if (shmDat.offs != -1) {
+      lseek(fd, shmDat.offs, SEEK_SET);
+    }
+  }
+  
+  queue->len = 0;
+  queue->digest = 0;
+  if (shmDat.ret == -1) {
+    plrlog(LOG_ERROR, "[%d:write] ERROR: Batched write to fd %d failed (%d)\n", getpid(), fd, shmDat.err);
+    errno = shmDat.err;
+    return -1;
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int isUnseekable(int fd) {
+  // Same answer in every process, they all share the open files
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    return 0;
+  }
+  return S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode) || S_ISCHR(st.st_mode);
+}
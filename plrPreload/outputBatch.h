@@ -0,0 +1,47 @@
+#ifndef OUTPUT_BATCH_H
+#define OUTPUT_BATCH_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+// Output batching (plr -B). Instead of checking every output call, the
+// output wrappers queue their data & fold it into a digest. Every process
+// queues the same data in its own memory, so a process forked to replace
+// another one starts out with the same queue. The queue is checked &
+// written out by the master with a single checked syscall at a flush point:
+// fflush, fclose, close or fseek on its fd, any input call, exit, once the
+// queue holds the batching limit, or output to another fd. Only output to
+// a single fd is queued at a time, so all output is written in the order
+// the program produced it; it's only delayed. Output to stderr is written
+// out right away.
+//
+// Queued data bypasses the stdio buffers & the file offset, so only output
+// to pipes, sockets & character devices (ttys) is batched, where neither
+// can be observed. Output to regular files is checked call by call.
+
+// Returns 1 if output batching is enabled.
+int outBatch_isEnabled();
+
+// Returns 1 if output to fd is batched, for the caller to queue it with
+// outBatch_append. Otherwise the output queued for another fd is written
+// out first, so that the caller's own checked output follows it, & 0 is
+// returned. Must be called inside PLR.
+int outBatch_isBatched(int fd);
+
+// Queue count bytes of output for fd, flushing the output queued for
+// another fd first, & the queue itself once it reaches the batching limit
+// or fd is stderr. Returns 0 on success, -1 if that flush failed.
+// Must be called inside PLR.
+int outBatch_append(int fd, const void *buf, size_t count);
+
+// Check & write out the output queued for fd, or for any fd if fd is -1.
+// Returns 0 on success, or -1 with errno set as the master's write failed.
+// Must be called inside PLR.
+int outBatch_flush(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
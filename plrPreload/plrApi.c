@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "plr.h"
+#include "plrLog.h"
+#include "timeUtil.h"
+#include "outputBatch.h"
+#include "plrApi.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Global variables & defines
+
+// fds below this have their offset synchronized at plr_resume()
+#define PLRAPI_MAX_SYNC_FDS 1024
+
+typedef struct {
+  int fd;
+  off_t offs;
+} resumeFdOffset_t;
+
+// Number of plr_pause() calls not resumed yet
+static int g_pauseDepth = 0;
+
+// plr_check() state, the same in every process. g_checkCalls counts the
+// calls, & the next one checked is g_nextCheck. g_lastCheckCall is the
+// last one checked, at CLOCK_MONOTONIC time g_lastCheckNs.
+static unsigned long g_checkCalls = 0;
+static unsigned long g_nextCheck = 0;
+static unsigned long g_lastCheckCall = 0;
+static long long g_lastCheckNs = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void plr_pause() {
+  if (g_pauseDepth++ > 0) {
+    return;
+  }
+  plr_setInsidePLR();
+  plrlog(LOG_SYSCALL, "[%d:plr_pause] Pause protection\n", getpid());
+
+  // Output queued before the region is written out before it
+  if (outBatch_isEnabled()) {
+    outBatch_flush(-1);
+  }
+
+  syscallArgs_t args = {
+    .addr = PLR_ADDR_PAUSE,
+  };
+  plr_checkSyscallArgs(&args);
+
+  plr_clearInsidePLR();
+  plr_setPaused(1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void plr_resume() {
+  if (g_pauseDepth == 0) {
+    plrlog(LOG_ERROR, "[%d:plr_resume] ERROR: plr_resume without plr_pause, ignored\n", getpid());
+    return;
+  } else if (--g_pauseDepth > 0) {
+    return;
+  }
+  plr_setPaused(0);
+  plr_setInsidePLR();
+  plrlog(LOG_SYSCALL, "[%d:plr_resume] Resume protection\n", getpid());
+
+  syscallArgs_t args = {
+    .addr = PLR_ADDR_RESUME,
+  };
+
+  // Nested function actually performed by master process only
+  int masterAct() {
+    // Batched output bypasses stdio, so the output the master's stdio
+    // buffered while paused has to be written out before any queued after
+    if (outBatch_isEnabled()) {
+      fflush(NULL);
+    }
+
+    // Publish the offsets of the master's seekable fds, preceded by their
+    // count
+    int nFds = 0;
+    for (int fd = 0; fd < PLRAPI_MAX_SYNC_FDS; ++fd) {
+      resumeFdOffset_t fdOffs = { .fd = fd, .offs = lseek(fd, 0, SEEK_CUR) };
+      if (fdOffs.offs != -1) {
+        plr_copyToShm(&fdOffs, sizeof(fdOffs), sizeof(nFds) + nFds*sizeof(fdOffs));
+        ++nFds;
+      }
+    }
+    plr_copyToShm(&nFds, sizeof(nFds), 0);
+    return 0;
+  }
+  // All processes call plr_checkedMasterAction() to check arguments &
+  // synchronize at this point
+  plr_checkedMasterAction(&args, masterAct);
+
+  if (!plr_isExecutorProcess()) {
+    // Files opened while paused were opened by each process on its own, &
+    // only written by the master, so their offsets are caught up here
+    int nFds;
+    plr_copyFromShm(&nFds, sizeof(nFds), 0);
+    for (int i = 0; i < nFds; ++i) {
+      resumeFdOffset_t fdOffs;
+      plr_copyFromShm(&fdOffs, sizeof(fdOffs), sizeof(nFds) + i*sizeof(fdOffs));
+      if (lseek(fdOffs.fd, 0, SEEK_CUR) != fdOffs.offs) {
+        lseek(fdOffs.fd, fdOffs.offs, SEEK_SET);
+      }
+    }
+  }
+
+  plr_clearInsidePLR();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int plr_check(const void *ptr, size_t len) {
+  if (plr_checkInsidePLR()) {
+    // Unprotected region, nothing to check
+    return 0;
+  } else if (g_checkCalls++ < g_nextCheck) {
+    // Skipped to stay within the hashing budget
+    return 0;
+  }
+  plr_setInsidePLR();
+  plrlog(LOG_SYSCALL, "[%d:plr_check] Check %zu bytes at %p\n", getpid(), len, ptr);
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  unsigned long hash = plr_hash(PLR_HASH_STATE, 0, ptr, len);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  long long hashNs = tspecToNs(end) - tspecToNs(start);
+
+  syscallArgs_t args = {
+    .addr = PLR_ADDR_CHECK,
+    .arg[0] = hash,
+    .arg[1] = len,
+  };
+
+  // Nested function actually performed by master process only
+  unsigned long skip = 0;
+  int masterAct() {
+    // Skip enough of the following calls to keep the master's hashing time
+    // within the budget, going by the time per call since the last check.
+    // Decided by the master alone so that every process skips the same.
+    if (g_lastCheckNs != 0) {
+      long long callNs = (tspecToNs(end) - g_lastCheckNs) / (long long)(g_checkCalls - g_lastCheckCall);
+      long long budgetNs = (callNs > 0 ? callNs : 1) * plr_checkBudget() / 100;
+      skip = (budgetNs > 0) ? (hashNs + budgetNs-1) / budgetNs - 1 : 0;
+    }
+    plr_copyToShm(&skip, sizeof(skip), 0);
+    return 0;
+  }
+  // All processes call plr_checkedMasterAction() to check arguments &
+  // synchronize at this point. A process with different data is replaced.
+  plr_checkedMasterAction(&args, masterAct);
+
+  if (!plr_isExecutorProcess()) {
+    // Slaves copy the number of calls to skip from shared memory
+    plr_copyFromShm(&skip, sizeof(skip), 0);
+  }
+  g_nextCheck = g_checkCalls + skip;
+  g_lastCheckCall = g_checkCalls;
+  g_lastCheckNs = tspecToNs(end);
+
+  plr_clearInsidePLR();
+  return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef PLR_API_H
+#define PLR_API_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+// Public API for programs run under plr, provided by libplrPreload.so.
+// The functions are declared weak, so a program using them still links &
+// runs without plr, where they're NULL. Call them through the PLR_ macros,
+// which check for that.
+
+// Unprotected regions. Between plr_pause() & plr_resume(), the libc calls
+// of the program aren't checked & don't synchronize the redundant
+// processes. Each process runs them locally, except for calls with an
+// external effect (output, removing files) which only the master runs,
+// while the others return as if they succeeded. Meant for work that
+// doesn't need redundancy, like writing logs or scratch files.
+// Each process opens files on its own, but only the master creates or
+// truncates them, so exclusive creation may still fail in the master when
+// another process opened the file first.
+//
+// Both are checked calls themselves, so all processes enter & leave the
+// region at the same point. At plr_resume(), the other processes seek
+// their fds to the master's offsets, so the processes agree again on the
+// files they share. Output the master's stdio buffered while paused is
+// written out by the master alone, like protected output, & at
+// plr_resume() already with output batching. Input from fds shared
+// with the other processes, like stdin, mustn't be read while paused, since
+// every process would consume it. Regions may nest, only the outermost
+// pair synchronizes.
+void plr_pause() __attribute__((weak));
+void plr_resume() __attribute__((weak));
+
+#define PLR_PAUSE()  do { if (plr_pause) plr_pause(); } while (0)
+#define PLR_RESUME() do { if (plr_resume) plr_resume(); } while (0)
+
+// Application state checks. Hashes the len bytes at ptr & compares the hash
+// between the redundant processes like the arguments of a syscall, so a
+// fault that corrupted the data is found & repaired right away instead of
+// once it reaches the program's output. Meant for state that must be the
+// same in every process, checked e.g. after each step of a long compute
+// phase. Calls are skipped as needed to keep the time spent hashing within
+// the budget set by plr -K. Call at the same points in every process, not
+// while paused. Returns 0.
+int plr_check(const void *ptr, size_t len) __attribute__((weak));
+
+#define PLR_CHECK(ptr, len) do { if (plr_check) plr_check(ptr, len); } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+#endif
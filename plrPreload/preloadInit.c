@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "plr.h"
+#include "outputBatch.h"
 
 __attribute__((constructor))
 void initPLRPreload() {
@@ -12,5 +13,15 @@ void initPLRPreload() {
 
 __attribute__((destructor))
 void cleanupPLRPreload() {
-  
+  // Write out output still queued at exit, & compare the checks of the last
+  // calls, which were deferred to a later call that never comes. Skipped
+  // when exiting from inside PLR, which only happens on an error.
+  if (!plr_checkInsidePLR()) {
+    plr_setInsidePLR();
+    if (outBatch_isEnabled()) {
+      outBatch_flush(-1);
+    }
+    plr_checkDeferredAtExit();
+    plr_clearInsidePLR();
+  }
 }
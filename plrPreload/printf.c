@@ -10,7 +10,7 @@
 #include "plrLog.h"
 #include "stringUtil.h"
 #include "libc_func.h"
-#include "crc32_util.h"
+#include "outputBatch.h"
 
 typedef struct {
   int err;
@@ -21,7 +21,10 @@ int com_vfprintf(const char *fncName, FILE *stream, const char *format, va_list
   // Get libc syscall function pointer & offset in image
   libc_func(vfprintf, int, FILE *, const char *, va_list);
     
-  if (plr_checkInsidePLR()) {
+  if (plr_skipPausedEffect()) {
+    // Unprotected region, only the master writes the output
+    return vsnprintf(NULL, 0, format, ap);
+  } else if (plr_checkInsidePLR()) {
     // If already inside PLR code, just call original syscall & return
     return _vfprintf(stream, format, ap);
   } else {
@@ -46,13 +49,24 @@ int com_vfprintf(const char *fncName, FILE *stream, const char *format, va_list
       free(resStrFmt);
     }
     
+    if (outBatch_isBatched(fn)) {
+      // Queue the data, it's checked & written out at the next flush point
+      if (vasRet != -1) {
+        if (outBatch_append(fn, resStr, vasRet) < 0) {
+          vasRet = -1;
+        }
+        free(resStr);
+      }
+      plr_clearInsidePLR();
+      return vasRet;
+    }
+    
     syscallArgs_t args = {
       .addr = _off_vfprintf,
-      .arg[0] = crc32(0, fncName, strlen(fncName)),
+      .arg[0] = plr_hash(PLR_HASH_NAME, 0, fncName, strlen(fncName)),
       .arg[1] = fn,
-      .arg[2] = ((vasRet) ? crc32(0, resStr, strlen(resStr)) : 0),
+      .arg[2] = ((vasRet) ? plr_hash(PLR_HASH_DATA, 0, resStr, strlen(resStr)) : 0),
     };
-    plr_checkSyscallArgs(&args);
     if (vasRet != -1) {
       free(resStr);
     }
@@ -68,10 +82,11 @@ int com_vfprintf(const char *fncName, FILE *stream, const char *format, va_list
       plr_copyToShm(&shmDat, sizeof(shmDat), 0);
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedMasterAction() to check arguments &
+    // synchronize at this point
+    plr_checkedMasterAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       printfShmData_t shmDat;
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <pthread.h>
 #include <string.h>
@@ -8,7 +9,7 @@
 #include "plrLog.h"
 #include "plrSharedData.h"
 #include "libc_func.h"
-#include "crc32_util.h"
+#include "outputBatch.h"
 
 typedef struct {
   int err;
@@ -22,18 +23,31 @@ int puts(const char *s) {
   // Get libc syscall function pointer & offset in image
   libc_func(puts, int, const char *);
     
-  if (plr_checkInsidePLR()) {
+  if (plr_skipPausedEffect()) {
+    // Unprotected region, only the master writes the output
+    return strlen(s) + 1;
+  } else if (plr_checkInsidePLR()) {
     // If already inside PLR code, just call original syscall & return
     return _puts(s);
   } else {
     plr_setInsidePLR();
     plrlog(LOG_SYSCALL, "[%d:puts] Write '%s' to stdout\n", getpid(), s);
     
+    if (outBatch_isBatched(fileno(stdout))) {
+      // Queue the data, it's checked & written out at the next flush point
+      size_t len = strlen(s);
+      int ret = (len < INT_MAX) ? len+1 : INT_MAX;
+      if (outBatch_append(fileno(stdout), s, len) < 0 || outBatch_append(fileno(stdout), "\n", 1) < 0) {
+        ret = EOF;
+      }
+      plr_clearInsidePLR();
+      return ret;
+    }
+    
     syscallArgs_t args = {
       .addr = _off_puts,
-      .arg[0] = crc32(0, s, strlen(s)),
+      .arg[0] = plr_hash(PLR_HASH_DATA, 0, s, strlen(s)),
     };
-    plr_checkSyscallArgs(&args);
     
     // Nested function actually performed by master process only
     int ret;
@@ -52,6 +66,10 @@ int puts(const char *s) {
       shmDat.offs = ftell(stdout);
       shmDat.eof = feof(stdout);
       shmDat.ferr = ferror(stdout);
+      if (shmDat.eof) {
+        // Slaves read at EOF to set their own EOF flag
+        plr_waitForSlavesAfterAction();
+      }
       
       // Store return value in shared memory for slave processes
       plr_copyToShm(&shmDat, sizeof(shmDat), 0);
@@ -65,10 +83,11 @@ int puts(const char *s) {
       
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedMasterAction() to check arguments &
+    // synchronize at this point
+    plr_checkedMasterAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
       
@@ -97,13 +116,13 @@ int puts(const char *s) {
     // TEMPORARY
     // Slave processes sometimes end up with the wrong file offset, even after SEEK_SET
     // Compare file state at exit to make sure everything is consistent
-    // Piggybacking off checkSyscallArgs mechanism to do this
+    // Deferred so it gets checked along with the next syscall's arguments
     syscallArgs_t exitState = {
       .arg[0] = ftell(stdout),
       .arg[1] = feof(stdout),
       .arg[2] = ferror(stdout),
     };
-    plr_checkSyscallArgs(&exitState);
+    plr_deferSyscallArgsCheck(&exitState);
     
     // All procs return same value & errno
     ret = shmDat.ret;
@@ -4,6 +4,7 @@
 #include "plr.h"
 #include "plrLog.h"
 #include "libc_func.h"
+#include "outputBatch.h"
 
 #include <stdio.h>
 
@@ -11,6 +12,8 @@ typedef struct {
   int err;
   ssize_t ret;
   off_t offs;
+  // Digest of the data read, checked by the slaves as they copy it
+  unsigned long digest;
 } readShmData_t;
 
 ssize_t read(int fd, void *buf, size_t count) {  
@@ -24,6 +27,12 @@ ssize_t read(int fd, void *buf, size_t count) {
     plr_setInsidePLR();
     plrlog(LOG_SYSCALL, "[%d:read] Read (up to) %ld bytes from fd %d\n", getpid(), count, fd);
     
+    if (outBatch_isEnabled()) {
+      // Output queued for any fd is written out before reading, so that
+      // e.g. a prompt on stdout shows up before the read from stdin
+      outBatch_flush(-1);
+    }
+    
     // Not comparing buf argument, different processes could have different
     // VM mappings and still be valid
     syscallArgs_t args = {
@@ -32,9 +41,8 @@ ssize_t read(int fd, void *buf, size_t count) {
       .arg[1] = 0, //(unsigned long)buf,
       .arg[2] = count
     };
-    plr_checkSyscallArgs(&args);
     
-    // Nested function actually performed by master process only
+    // Nested function actually performed by the executor process only
     ssize_t ret;
     int masterAct() {
       // Call original libc function
@@ -47,21 +55,22 @@ ssize_t read(int fd, void *buf, size_t count) {
       }
       
       // Store return value & returned data in shared memory for slave processes
-      plr_copyToShm(&shmDat, sizeof(shmDat), 0);
       if (shmDat.ret > 0) {
-        plr_copyToShm(buf, ret, sizeof(shmDat));
+        shmDat.digest = plr_copyToShmHashed(buf, ret, sizeof(shmDat));
       }
+      plr_copyToShm(&shmDat, sizeof(shmDat), 0);
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedExecutorAction() to check arguments &
+    // synchronize at this point
+    plr_checkedExecutorAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       readShmData_t shmDat;
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
       if (shmDat.ret > 0) {
-        plr_copyFromShm(buf, shmDat.ret, sizeof(shmDat));
+        plr_copyFromShmChecked(buf, shmDat.ret, sizeof(shmDat), shmDat.digest);
       }
       
       // Slaves seek to new fd offset
@@ -4,7 +4,6 @@
 #include "plr.h"
 #include "plrLog.h"
 #include "libc_func.h"
-#include "crc32_util.h"
 
 typedef struct {
   int err;
@@ -15,7 +14,10 @@ int unlink(const char *pathname) {
   // Get libc syscall function pointer & offset in image
   libc_func(unlink, int, const char *);
   
-  if (plr_checkInsidePLR()) {
+  if (plr_skipPausedEffect()) {
+    // Unprotected region, only the master removes the file
+    return 0;
+  } else if (plr_checkInsidePLR()) {
     // If already inside PLR code, just call original syscall & return
     return _unlink(pathname);
   } else {
@@ -24,11 +26,10 @@ int unlink(const char *pathname) {
     
     syscallArgs_t args = {
       .addr = _off_unlink,
-      .arg[0] = crc32(0, pathname, strlen(pathname)),
+      .arg[0] = plr_hash(PLR_HASH_NAME, 0, pathname, strlen(pathname)),
     };
-    plr_checkSyscallArgs(&args);
     
-    // Nested function actually performed by master process only
+    // Nested function actually performed by the executor process only
     int ret;
     int masterAct() {
       // Call original libc function
@@ -39,10 +40,11 @@ int unlink(const char *pathname) {
       plr_copyToShm(&shmDat, sizeof(shmDat), 0);
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedExecutorAction() to check arguments &
+    // synchronize at this point
+    plr_checkedExecutorAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       unlinkShmData_t shmDat;
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
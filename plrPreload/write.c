@@ -4,7 +4,7 @@
 #include "plr.h"
 #include "plrLog.h"
 #include "libc_func.h"
-#include "crc32_util.h"
+#include "outputBatch.h"
 
 #include <stdio.h>
 
@@ -18,22 +18,31 @@ ssize_t write(int fd, const void *buf, size_t count) {
   // Get libc syscall function pointer & offset in image
   libc_func(write, ssize_t, int, const void *, size_t);
     
-  if (plr_checkInsidePLR()) {
+  if (plr_skipPausedEffect()) {
+    // Unprotected region, only the master writes the output
+    return count;
+  } else if (plr_checkInsidePLR()) {
     // If already inside PLR code, just call original syscall & return
     return _write(fd, buf, count);
   } else {
     plr_setInsidePLR();
     plrlog(LOG_SYSCALL, "[%d:write] Write %ld bytes to fd %d\n", getpid(), count, fd);
     
+    if (outBatch_isBatched(fd)) {
+      // Queue the data, it's checked & written out at the next flush point
+      ssize_t ret = (outBatch_append(fd, buf, count) < 0) ? -1 : (ssize_t)count;
+      plr_clearInsidePLR();
+      return ret;
+    }
+    
     syscallArgs_t args = {
       .addr = _off_write,
       .arg[0] = fd,
-      .arg[1] = crc32(0, buf, count),
+      .arg[1] = plr_hash(PLR_HASH_DATA, 0, buf, count),
       .arg[2] = count
     };
-    plr_checkSyscallArgs(&args);
     
-    // Nested function actually performed by master process only
+    // Nested function actually performed by the executor process only
     ssize_t ret;
     int masterAct() {
       // Call original libc function
@@ -49,10 +58,11 @@ ssize_t write(int fd, const void *buf, size_t count) {
       plr_copyToShm(&shmDat, sizeof(shmDat), 0);
       return 0;
     }
-    // All processes call plr_masterAction() to synchronize at this point
-    plr_masterAction(masterAct);
+    // All processes call plr_checkedExecutorAction() to check arguments &
+    // synchronize at this point
+    plr_checkedExecutorAction(&args, masterAct);
     
-    if (!plr_isMasterProcess()) {
+    if (!plr_isExecutorProcess()) {
       // Slaves copy return values from shared memory
       writeShmData_t shmDat;
       plr_copyFromShm(&shmDat, sizeof(shmDat), 0);
@@ -0,0 +1,70 @@
+// Fault injection test program.
+//
+// Prints a line per iteration. Halfway through, the first redundant process
+// to create the marker file (with raw syscalls, so plr doesn't see it)
+// misbehaves:
+//   diverge : prints a different line
+//   die     : exits right away
+//   hang    : sleeps, so the watchdog expires
+//   memory  : corrupts a global it never prints, only found by scrubbing
+//             (plr -S), & then makes 5*iterations getpid calls, more
+//             than all of its output calls
+//   none    : nothing, for a run without a fault
+// Under plr, the output must be the same as a native run of the program
+// with mode none, unless plr can only detect the fault (exit status 3).
+//
+// Usage: faultInject <mode> <marker file> [iterations]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Global variables & defines
+
+static unsigned long g_hidden[1024];
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <mode> <marker file> [iterations]\n", argv[0]);
+    return 1;
+  }
+  const char *mode = argv[1];
+  const char *marker = argv[2];
+  int iters = (argc > 3) ? atoi(argv[3]) : 20;
+
+  for (int i = 0; i < iters; ++i) {
+    char line[64];
+    snprintf(line, sizeof(line), "line %d\n", i);
+    g_hidden[i % 1024] += i;
+    if (i == iters/2 && strcmp(mode, "none") != 0) {
+      int fd = syscall(SYS_open, marker, O_CREAT | O_EXCL | O_WRONLY, 0600);
+      if (fd >= 0) {
+        syscall(SYS_close, fd);
+        if (strcmp(mode, "diverge") == 0) {
+          line[0] = 'X';
+        } else if (strcmp(mode, "die") == 0) {
+          syscall(SYS_exit_group, 7);
+        } else if (strcmp(mode, "hang") == 0) {
+          sleep(2);
+        } else if (strcmp(mode, "memory") == 0) {
+          g_hidden[777] ^= 4;
+        }
+      }
+      if (strcmp(mode, "memory") == 0) {
+        // Checked calls that don't depend on g_hidden, in every process
+        for (int j = 0; j < 5*iters; ++j) {
+          getpid();
+        }
+      }
+    }
+    fputs(line, stdout);
+    fflush(stdout);
+  }
+  return 0;
+}
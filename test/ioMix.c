@@ -0,0 +1,98 @@
+// Smoke test program exercising the wrapped libc calls.
+//
+// Writes a scratch file through stdio & raw fds, reads it back, and prints
+// what it saw: file offsets, stdio state, line & byte counts. Its output
+// must be the same under plr in every mode as in a native run. stdout is
+// flushed before every raw write to it, so that the order of the output
+// doesn't depend on how it's buffered.
+//
+// Usage: ioMix <scratch file> [iterations]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "plrApi.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Global variables & defines
+
+// State that every redundant process must agree on, checked with plr_check
+static unsigned long g_state[256];
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <scratch file> [iterations]\n", argv[0]);
+    return 1;
+  }
+  const char *path = argv[1];
+  int iters = (argc > 2) ? atoi(argv[2]) : 20;
+
+  // Stdio output to a regular file, the stream state must stay correct
+  FILE *f = fopen(path, "w+");
+  if (f == NULL) {
+    perror("fopen");
+    return 1;
+  }
+  for (int i = 0; i < iters; ++i) {
+    fprintf(f, "line %d\n", i);
+    fputs("abc\n", f);
+    fputc('z', f);
+    fwrite("0123456789\n", 1, 11, f);
+    if (i % 5 == 0) {
+      printf("iter %d ftell %ld eof %d err %d\n", i, ftell(f), feof(f), ferror(f));
+    }
+  }
+  fflush(f);
+
+  // Read it back through stdio
+  fseek(f, 0, SEEK_SET);
+  char buf[128];
+  int nLines = 0;
+  while (fgets(buf, sizeof(buf), f) != NULL) {
+    nLines++;
+  }
+  printf("lines %d eof %d\n", nLines, feof(f));
+  fseek(f, 5, SEEK_SET);
+  int c = fgetc(f);
+  size_t nRead = fread(buf, 1, 16, f);
+  printf("fgetc %c fread %zu '%.16s' ftell %ld\n", c, nRead, buf, ftell(f));
+  fclose(f);
+
+  // And through a raw fd
+  int fd = open(path, O_RDONLY);
+  long total = 0;
+  ssize_t r;
+  while ((r = read(fd, buf, sizeof(buf))) > 0) {
+    total += r;
+  }
+  close(fd);
+  unlink(path);
+  printf("bytes %ld\n", total);
+
+  // Calls without external effects, folded with plr -E
+  int pid = getpid();
+  int samePid = 1;
+  for (int i = 0; i < 3*iters; ++i) {
+    samePid &= (getpid() == pid);
+  }
+  printf("getpid %d\n", samePid);
+
+  // Application state checks
+  for (int i = 0; i < iters; ++i) {
+    g_state[i % 256] += i;
+    PLR_CHECK(g_state, sizeof(g_state));
+  }
+
+  // Mixed stdout output & stderr
+  fflush(stdout);
+  for (int i = 0; i < iters; ++i) {
+    write(1, "w", 1);
+  }
+  write(1, "\n", 1);
+  fprintf(stderr, "to stderr\n");
+  puts("done");
+  return 0;
+}
@@ -0,0 +1,142 @@
+// Test program for function-level redundancy (plrRedundant.h), run
+// natively rather than under plr. Prints the checks that fail to stderr &
+// exits with their number.
+//
+// Usage: redundantTest <marker file>
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "plrRedundant.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Global variables & defines
+
+typedef struct {
+  // Summed & scaled by g_scale
+  int vals[8];
+  // Misbehavior of the first worker to create the marker file, see misbehave
+  const char *fault;
+} callArg_t;
+
+typedef struct {
+  long sum;
+  // Calls this worker ran, more than 1 only if workers are reused
+  int calls;
+} callOut_t;
+
+// Read by the workers, but written by the caller between calls
+static int g_scale = 1;
+static int g_workerCalls = 0;
+static const char *g_marker;
+static int g_nFail = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void misbehave(const char *fault, callOut_t *out) {
+  if (fault == NULL || strcmp(fault, "none") == 0) {
+    return;
+  }
+  int fd = open(g_marker, O_CREAT | O_EXCL | O_WRONLY, 0600);
+  if (fd < 0) {
+    return;
+  }
+  close(fd);
+  if (strcmp(fault, "diverge") == 0) {
+    out->sum += 1000;
+  } else if (strcmp(fault, "die") == 0) {
+    _exit(1);
+  } else if (strcmp(fault, "hang") == 0) {
+    sleep(10);
+  }
+}
+
+static void scaledSum(const void *argPtr, void *outPtr) {
+  const callArg_t *arg = argPtr;
+  callOut_t *out = outPtr;
+  out->sum = 0;
+  for (int i = 0; i < 8; ++i) {
+    out->sum += arg->vals[i] * g_scale;
+  }
+  out->calls = ++g_workerCalls;
+  misbehave(arg->fault, out);
+}
+
+static void pidOut(const void *arg, void *out) {
+  (void)arg;
+  *(int*)out = getpid();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void check(int ok, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "FAIL %s\n", what);
+    g_nFail++;
+  }
+}
+
+static double msSince(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec)*1000.0 + (now.tv_nsec - start->tv_nsec)/1e6;
+}
+
+// Runs scaledSum with fault & checks the result against a native call
+static void checkCall(const char *fault, const char *what) {
+  callArg_t arg = { .vals = { 1, 2, 3, 4, 5, 6, 7, 21 }, .fault = "none" };
+  callOut_t expected;
+  int savedCalls = g_workerCalls;
+  scaledSum(&arg, &expected);
+  g_workerCalls = savedCalls;
+  arg.fault = fault;
+
+  unlink(g_marker);
+  callOut_t out = { 0, 0 };
+  int ret = plr_runRedundant(scaledSum, &arg, sizeof(arg), &out, sizeof(out));
+  check(ret == 0 && out.sum == expected.sum, what);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <marker file>\n", argv[0]);
+    return 1;
+  }
+  g_marker = argv[1];
+
+  checkCall("none", "plain call");
+  g_scale = 10;
+  checkCall("none", "call after the caller changed memory fn reads");
+  checkCall("diverge", "call with a diverging worker");
+
+  // A dead worker is voted out right away, not after the timeout
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  checkCall("die", "call with a dying worker");
+  check(msSince(&start) < PLR_REDUNDANT_DEFAULT_TIMEOUT_MS/2, "dead worker noticed before the timeout");
+  checkCall("hang", "call with a hanging worker");
+
+  int pid;
+  check(plr_runRedundant(pidOut, NULL, 0, &pid, sizeof(pid)) == -1, "call without a majority fails");
+
+  // Reused workers keep their memory until the caller says it changed
+  plr_redundantSetReuse(1);
+  callArg_t arg = { .vals = { 1 }, .fault = "none" };
+  callOut_t out1, out2;
+  plr_runRedundant(scaledSum, &arg, sizeof(arg), &out1, sizeof(out1));
+  plr_runRedundant(scaledSum, &arg, sizeof(arg), &out2, sizeof(out2));
+  check(out2.calls == out1.calls+1, "workers are reused");
+  g_scale = 100;
+  plr_redundantMemoryChanged();
+  checkCall("none", "reused workers see memory after plr_redundantMemoryChanged");
+  checkCall("die", "reused workers replace a dead one");
+  checkCall("none", "call after replacing a reused worker");
+
+  plr_redundantExit();
+  return g_nFail;
+}
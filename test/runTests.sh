@@ -0,0 +1,142 @@
+#!/bin/bash
+# Smoke tests for plr. Runs the test programs under plr in every mode &
+# compares their output with a native run, then injects faults into one of
+# the redundant processes & checks that plr recovers, or detects the fault
+# where it can't recover. Exits with the number of failed tests.
+#
+# Usage: runTests.sh [plr binary], default plr in the repository root.
+# Run through "make check" in this directory, which builds the programs.
+# Runs from the repository root, since plr preloads ./lib/libplrPreload.so.
+
+cd "$(dirname "$0")/.." || exit 1
+PLR=$(realpath "${1:-plr}")
+TMP=$(mktemp -d /tmp/plrTest.XXXXXX) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+TIMEOUT=60
+ITERS=20
+
+nRun=0
+nFail=0
+
+###############################################################################
+
+# runCase <description> <expected status> <expected stdout file> <command...>
+# Runs the command with stdout through a pipe, like most programs are run,
+# & checks its exit status & stdout. With EXPECT_LOG set, its stderr must
+# also match that pattern. With OUT_FILTER set, lines of stdout matching
+# that pattern are left out of the comparison.
+runCase() {
+  local desc=$1 expStatus=$2 expOut=$3
+  shift 3
+  nRun=$((nRun+1))
+  rm -f "$TMP"/marker
+  timeout $TIMEOUT "$@" 2>"$TMP/err" | cat >"$TMP/out"
+  local status=${PIPESTATUS[0]}
+  if [ -n "$OUT_FILTER" ]; then
+    grep -v "$OUT_FILTER" "$TMP/out" >"$TMP/out.filtered"
+    mv "$TMP/out.filtered" "$TMP/out"
+  fi
+  if [ "$status" != "$expStatus" ]; then
+    fail "$desc" "exit status $status, expected $expStatus"
+  elif [ "$expStatus" == 0 ] && ! cmp -s "$TMP/out" "$expOut"; then
+    fail "$desc" "output differs from native run"
+    diff "$expOut" "$TMP/out" | head -5
+  elif [ -n "$EXPECT_LOG" ] && ! grep -q "$EXPECT_LOG" "$TMP/err"; then
+    fail "$desc" "no '$EXPECT_LOG' in its log"
+  else
+    echo "ok   $desc"
+  fi
+}
+
+fail() {
+  nFail=$((nFail+1))
+  echo "FAIL $1: $2"
+  sed 's/^/     /' "$TMP/err" | tail -5
+}
+
+###############################################################################
+# Output of every mode matches a native run
+
+IO_MODES=(
+  "-n 3" "-n 2" "-n 5"
+  "-b futex" "-b tree -n 5" "-s 50" "-b futex -s 50"
+  "-q" "-q -n 5"
+  "-A 8" "-A 1"
+  "-E 8" "-E 8 -n 2"
+  "-B 4096" "-B 16" "-B 4096 -A 8"
+  "-K 100"
+  "-S 4" "-S 1 -n 2"
+  "-H name=xxh -H data=crc32c -H state=crc32c"
+  "-r 100" "-r 1"
+  "-c 50" "-c 1 -n 2"
+  "-a 50 -W $TMP/skew"
+)
+
+test/ioMix "$TMP/scratch" $ITERS >"$TMP/ioMix.exp" 2>/dev/null
+for opts in "${IO_MODES[@]}"; do
+  runCase "ioMix $opts" 0 "$TMP/ioMix.exp" "$PLR" $opts -- test/ioMix "$TMP/scratch" $ITERS
+done
+
+runCase "ioMix -R" 0 "$TMP/ioMix.exp" "$PLR" -R "$TMP/log" -- test/ioMix "$TMP/scratch" $ITERS
+# Verify mode uses the recorded results instead of running the actions,
+# so it has no output of its own
+runCase "ioMix -V" 0 /dev/null "$PLR" -V "$TMP/log" -- test/ioMix "$TMP/scratch" $ITERS
+
+###############################################################################
+# Faults are repaired, or only detected with 2 processes
+
+test/faultInject none "$TMP/marker" $ITERS >"$TMP/fault.exp"
+
+RECOVER_MODES=(
+  "-n 3" "-n 3 -b futex" "-n 5 -b tree" "-n 3 -q"
+  "-n 3 -A 8" "-n 3 -E 4" "-n 3 -B 64" "-n 3 -S 4"
+)
+for fault in diverge die hang; do
+  for opts in "${RECOVER_MODES[@]}"; do
+    # In asynchronous mode, the output of a diverging master is already
+    # written when the slaves catch it, the replacement writes it again
+    if [ "$fault" == diverge ] && [[ "$opts" == *-A* ]]; then
+      OUT_FILTER="^Xine"
+    fi
+    runCase "faultInject $fault $opts" 0 "$TMP/fault.exp" "$PLR" $opts -- test/faultInject $fault "$TMP/marker" $ITERS
+    OUT_FILTER=
+  done
+done
+
+# Adaptive redundancy runs a pair until the first fault, which can only
+# replace a process that died or hung
+for fault in die hang; do
+  runCase "faultInject $fault -r 100" 0 "$TMP/fault.exp" "$PLR" -r 100 -- test/faultInject $fault "$TMP/marker" $ITERS
+done
+runCase "faultInject diverge -r 100" 3 "$TMP/fault.exp" "$PLR" -r 100 -- test/faultInject diverge "$TMP/marker" $ITERS
+
+runCase "faultInject diverge -n 2" 3 "$TMP/fault.exp" "$PLR" -n 2 -- test/faultInject diverge "$TMP/marker" $ITERS
+# A rollback reruns the calls since the checkpoint without the fault
+runCase "faultInject diverge -n 2 -c 1" 0 "$TMP/fault.exp" "$PLR" -n 2 -c 1 -- test/faultInject diverge "$TMP/marker" $ITERS
+
+# Corrupted memory that never reaches a checked call is only found by
+# scrubbing. The program makes fewer output calls than the scrub interval,
+# so the scrubs also have to count its getpid calls.
+SCRUB=$((ITERS+5))
+runCase "faultInject memory -n 2 -S $SCRUB" 3 "$TMP/fault.exp" "$PLR" -n 2 -S $SCRUB -- test/faultInject memory "$TMP/marker" $ITERS
+EXPECT_LOG="Replacing faulted pid"
+for opts in "-n 3" "-n 3 -b futex" "-n 3 -E 4"; do
+  runCase "faultInject memory $opts -S $SCRUB" 0 "$TMP/fault.exp" env PLR_LOGLEVEL=3 "$PLR" $opts -S $SCRUB -- test/faultInject memory "$TMP/marker" $ITERS
+done
+EXPECT_LOG=
+
+###############################################################################
+# Function-level redundancy, run natively
+
+runCase "redundantTest" 0 /dev/null test/redundantTest "$TMP/marker"
+
+###############################################################################
+# Invalid options are rejected
+
+runCase "reject -W without -a" 1 /dev/null "$PLR" -W "$TMP/skew" -- test/faultInject none "$TMP/marker"
+runCase "reject -A 0" 1 /dev/null "$PLR" -A 0 -- test/faultInject none "$TMP/marker"
+
+###############################################################################
+
+echo "$((nRun-nFail)) of $nRun tests passed"
+exit $nFail